@@ -0,0 +1,8 @@
+#include "AnalysisTask.h"
+
+ClassImp(AnalysisTask)
+
+AnalysisTask::AnalysisTask(const char *name, const char *title):
+  TNamed(name, title)
+{
+};
@@ -0,0 +1,38 @@
+#ifndef ANALYSISTASK__H
+#define ANALYSISTASK__H
+
+#include "TNamed.h"
+
+class TDirectory;
+class EventKinematics;
+class EstimatorEngine;
+
+// What makeTreeSoRt hands to the tasks for every accepted event
+struct AnalysisEvent {
+  EventKinematics *fKin;          // all particles, with the reco bit set
+  EstimatorEngine *fEstimators;   // multiplicities of the event
+  Float_t  fSo[4];                // gen, genNoPt, rec, recNoPt, -1 if not computed
+  Float_t  fPtLead[2];            // leading charged particle, gen and rec
+  Float_t  fPhiLead[2];
+  Float_t  fEtaLead[2];
+  Double_t fWeight;               // generator event weight
+};
+
+// Analysis run inside makeTreeSoRt on every event, filling histograms
+// directly instead of (or next to) the trees. Every thread has its own
+// task: Init() creates the output objects in the directory of the thread,
+// they are written and merged with the rest of the file (TBufferMerger,
+// and hadd for several jobs), so they must be additive.
+class AnalysisTask : public TNamed {
+ public:
+  AnalysisTask(const char *name = "AnalysisTask", const char *title = "");
+  virtual ~AnalysisTask() {}
+
+  virtual void Init(TDirectory *dir) = 0;
+  virtual void Process(const AnalysisEvent &event) = 0;
+  virtual void Finish() {}
+
+  ClassDef(AnalysisTask, 1);	// In-generator analysis task
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include "AsyncTreeWriter.h"
+
+#include "TTree.h"
+#include "TBranch.h"
+#include "TLeaf.h"
+#include "TDirectory.h"
+
+#include <cstring>
+
+ClassImp(AsyncTreeWriter)
+
+AsyncTreeWriter::AsyncTreeWriter(Int_t queueSize):
+  TNamed("AsyncTreeWriter", "TTree filling on a writer thread"),
+  fQueue(queueSize > 0 ? queueSize : 1),
+  fHead(0),
+  fCount(0),
+  fStop(kFALSE),
+  fNWaits(0)
+{
+};
+
+//____________________________________________________________________
+AsyncTreeWriter::~AsyncTreeWriter() 
+{
+  Stop();
+};
+
+//____________________________________________________________________
+Int_t AsyncTreeWriter::Add(TTree *source, TDirectory *dir) 
+{
+  if(fThread.joinable()) {
+    Error("Add", "the writer is already running");
+    return -1;
+  }
+
+  TIter next(source->GetListOfBranches());
+  while(TBranch *b = (TBranch*)next())
+    if(b->IsA() != TBranch::Class() || b->GetListOfLeaves()->GetEntriesFast() != 1 || b->GetListOfBranches()->GetEntriesFast()) {
+      Error("Add", "%s.%s is not a single leaf-list branch", source->GetName(), b->GetName());
+      return -1;
+    }
+
+  TDirectory *save = gDirectory;
+  dir->cd();
+  Tree t;
+  t.fOut = new TTree(source->GetName(), source->GetTitle());
+  save->cd();
+
+  // the branches keep their leaf lists (types, Float16 ranges, count leaves)
+  t.fBranches.resize(source->GetListOfBranches()->GetEntriesFast());
+  for(UInt_t i = 0; i < t.fBranches.size(); i++) {
+    TBranch *b = (TBranch*)source->GetListOfBranches()->At(i);
+    Branch &out = t.fBranches[i];
+    out.fSource = (TLeaf*)b->GetListOfLeaves()->At(0);
+    out.fBuffer.resize(out.fSource->GetLenType() * (out.fSource->GetLenStatic() > 0 ? out.fSource->GetLenStatic() : 1));
+    out.fOut = t.fOut->Branch(b->GetName(), out.fBuffer.data(), b->GetTitle());
+  }
+
+  fTrees.push_back(t);
+  return fTrees.size()-1;
+};
+
+//____________________________________________________________________
+void AsyncTreeWriter::Start() 
+{
+  if(fThread.joinable())
+    return;
+  fStop = kFALSE;
+  fThread = std::thread(&AsyncTreeWriter::Run, this);
+};
+
+//____________________________________________________________________
+void AsyncTreeWriter::Fill(Int_t i) 
+{
+  std::unique_lock<std::mutex> lock(fMutex);
+  if(fCount == (Int_t)fQueue.size()) {
+    fNWaits++;
+    fNotFull.wait(lock, [this] { return fCount < (Int_t)fQueue.size(); });
+  }
+  Record &record = fQueue[(fHead + fCount) % fQueue.size()];
+  lock.unlock();
+
+  // the slot is not visible to the writer before fCount is increased
+  record.fTree = i;
+  record.fData.clear();
+  for(UInt_t iB = 0; iB < fTrees[i].fBranches.size(); iB++) {
+    TLeaf *leaf = fTrees[i].fBranches[iB].fSource;
+    Int_t n = leaf->GetLenType() * leaf->GetLen();
+    const char *value = (const char*)leaf->GetValuePointer();
+    record.fData.insert(record.fData.end(), (const char*)&n, (const char*)&n + sizeof(n));
+    record.fData.insert(record.fData.end(), value, value + n);
+  }
+
+  lock.lock();
+  fCount++;
+  lock.unlock();
+  fNotEmpty.notify_one();
+};
+
+//____________________________________________________________________
+void AsyncTreeWriter::Restore(Record &record) 
+{
+  Tree &t = fTrees[record.fTree];
+  const char *data = record.fData.data();
+  for(UInt_t iB = 0; iB < t.fBranches.size(); iB++) {
+    Branch &b = t.fBranches[iB];
+    Int_t n;
+    memcpy(&n, data, sizeof(n));
+    data += sizeof(n);
+    if(n > (Int_t)b.fBuffer.size()) {
+      b.fBuffer.resize(2*n);
+      b.fOut->SetAddress(b.fBuffer.data());
+    }
+    memcpy(b.fBuffer.data(), data, n);
+    data += n;
+  }
+  t.fOut->Fill();
+};
+
+//____________________________________________________________________
+void AsyncTreeWriter::Run() 
+{
+  std::unique_lock<std::mutex> lock(fMutex);
+  while(true) {
+    fNotEmpty.wait(lock, [this] { return fCount > 0 || fStop; });
+    if(!fCount)
+      break;
+    Record &record = fQueue[fHead];
+    lock.unlock();
+
+    Restore(record);
+
+    lock.lock();
+    fHead = (fHead + 1) % fQueue.size();
+    fCount--;
+    fNotFull.notify_one();
+  }
+};
+
+//____________________________________________________________________
+void AsyncTreeWriter::Stop() 
+{
+  if(!fThread.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fStop = kTRUE;
+  }
+  fNotEmpty.notify_one();
+  fThread.join();
+};
@@ -0,0 +1,69 @@
+#ifndef ASYNCTREEWRITER__H
+#define ASYNCTREEWRITER__H
+
+#include "TNamed.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TTree;
+class TBranch;
+class TLeaf;
+class TDirectory;
+
+// Moves TTree::Fill (basket compression and writing) to a writer thread.
+// Add() makes an output copy of a source tree, whose branches point at the
+// variables filled by the generator. Fill() copies the current values of
+// all source branches into a queue and returns, the writer thread restores
+// them into the output tree buffers and fills it. Only branches with a
+// single leaf-list leaf are supported (the event summary, columnar tracks).
+// The output trees must only be touched by the writer until Stop().
+class AsyncTreeWriter : public TNamed {
+ public:
+  AsyncTreeWriter(Int_t queueSize = 256);
+  ~AsyncTreeWriter();
+
+  Int_t Add(TTree *source, TDirectory *dir); // index of the output tree, -1 if not supported
+  TTree* GetTree(Int_t i) { return fTrees[i].fOut; }
+
+  void Start();
+  void Fill(Int_t i);
+  void Stop();    // writes out the queue and joins the writer thread
+
+  Long64_t GetNWaits() { return fNWaits; } // Fill() calls that found the queue full
+
+ private:
+  struct Branch {
+    TLeaf *fSource;
+    TBranch *fOut;
+    std::vector<char> fBuffer;
+  };
+  struct Tree {
+    TTree *fOut;
+    std::vector<Branch> fBranches;
+  };
+  struct Record {
+    Int_t fTree;
+    std::vector<char> fData; // per branch the number of bytes and the bytes
+  };
+
+  void Run();
+  void Restore(Record &record);
+
+  std::vector<Tree>   fTrees;    //!
+  std::vector<Record> fQueue;    //! ring buffer
+  Int_t fHead;                   //! next to write
+  Int_t fCount;                  //! records in the queue
+  Bool_t fStop;                  //!
+  Long64_t fNWaits;              //!
+  std::mutex fMutex;             //!
+  std::condition_variable fNotEmpty; //!
+  std::condition_variable fNotFull;  //!
+  std::thread fThread;           //!
+
+  ClassDef(AsyncTreeWriter, 1);	// TTree filling on a writer thread
+};
+
+#endif
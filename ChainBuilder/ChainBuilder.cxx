@@ -0,0 +1,309 @@
+#include "ChainBuilder.h"
+
+#include "TChain.h"
+#include "TFile.h"
+#include "TTree.h"
+#include "TH1.h"
+#include "TMath.h"
+#include "TKey.h"
+#include "TROOT.h"
+#include "TSystem.h"
+#include "TDirectory.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+ClassImp(ChainBuilder)
+
+ChainBuilder::ChainBuilder(const char *treeName):
+  TNamed("ChainBuilder", "Chain builder"),
+  fTreeName(treeName),
+  fNThreads(0),
+  fManifest(""),
+  fManifestSet(kFALSE),
+  fNOpened(0)
+{
+};
+
+//____________________________________________________________________
+Bool_t ChainBuilder::Build(const char *input)
+{
+  fFiles.clear();
+  fGood.clear();
+  fNOpened = 0;
+
+  std::vector<std::string> paths;
+  std::string in = input;
+  if(in.find(".lis") != std::string::npos) {
+    std::ifstream list(input);
+    if(!list) {
+      Error("Build", "cannot open list file %s", input);
+      return kFALSE;
+    }
+    std::string path;
+    while(std::getline(list, path))
+      if(path.find(".root") != std::string::npos)
+        paths.push_back(path);
+    if(!fManifestSet)
+      fManifest = Form("%s.manifest.root", input);
+  }
+  else if(in.find(".root") != std::string::npos) {
+    paths.push_back(in);
+    if(!fManifestSet)
+      fManifest = "";
+  }
+  else {
+    Error("Build", "no good input file %s", input);
+    return kFALSE;
+  }
+
+  // files in the manifest with the same size and modification time are not reopened
+  std::map<std::string, File> known;
+  if(fManifest.Length())
+    ReadManifest(known);
+
+  std::vector<Int_t> toOpen;
+  fFiles.resize(paths.size());
+  for(UInt_t i = 0; i < paths.size(); i++) {
+    File &f = fFiles[i];
+    f.fPath = paths[i];
+    f.fSize = f.fMtime = f.fEntries = -1;
+    f.fGood = kFALSE;
+    f.fSoBins = 0;
+    FileStat_t stat;
+    if(!gSystem->GetPathInfo(f.fPath.c_str(), stat)) {
+      f.fSize = stat.fSize;
+      f.fMtime = stat.fMtime;
+    }
+    auto k = known.find(f.fPath);
+    if(f.fMtime >= 0 && k != known.end() && k->second.fSize == f.fSize && k->second.fMtime == f.fMtime)
+      f = k->second;
+    else
+      toOpen.push_back(i);
+  }
+
+  fNOpened = toOpen.size();
+  Int_t nThreads = fNThreads > 0 ? fNThreads : (Int_t)std::thread::hardware_concurrency();
+  nThreads = TMath::Min(TMath::Max(nThreads, 1), fNOpened);
+  if(nThreads > 1) {
+    ROOT::EnableThreadSafety();
+    std::atomic<Int_t> next(0);
+    std::vector<std::thread> threads;
+    for(Int_t iT = 0; iT < nThreads; iT++)
+      threads.emplace_back([&]() {
+        for(Int_t i = next++; i < fNOpened; i = next++)
+          Check(fFiles[toOpen[i]]);
+      });
+    for(auto &t : threads)
+      t.join();
+  }
+  else
+    for(auto i : toOpen)
+      Check(fFiles[i]);
+
+  for(UInt_t i = 0; i < fFiles.size(); i++)
+    if(fFiles[i].fGood)
+      fGood.push_back(i);
+  if(fManifest.Length() && fNOpened)
+    WriteManifest();
+
+  Info("Build", "%i good files out of %i, %i opened", (Int_t)fGood.size(), (Int_t)fFiles.size(), fNOpened);
+  return !fGood.empty();
+};
+
+//____________________________________________________________________
+void ChainBuilder::Check(File &f)
+{
+  // good: the tree is there and not empty
+  TDirectory::TContext context;
+  f.fGood = kFALSE;
+  f.fEntries = -1;
+  f.fSoNames.clear();
+  f.fSoBins = 0;
+  f.fSo.clear();
+
+  TFile *file = TFile::Open(f.fPath.c_str());
+  if(!file || file->IsZombie() || !file->GetNkeys()) {
+    delete file;
+    return;
+  }
+  TTree *tree = (TTree*)file->Get(fTreeName);
+  if(tree) {
+    f.fEntries = tree->GetEntries();
+    f.fGood = f.fEntries > 0;
+  }
+
+  TIter next(file->GetListOfKeys());
+  while(TKey *key = (TKey*)next()) {
+    TString name = key->GetName();
+    if(!name.BeginsWith("hEvSo_") || std::find(f.fSoNames.begin(), f.fSoNames.end(), name.Data()+6) != f.fSoNames.end())
+      continue; // only the highest cycle
+    TH1 *h = dynamic_cast<TH1*>(key->ReadObj());
+    if(h && (f.fSoNames.empty() || h->GetNbinsX() == f.fSoBins)) {
+      f.fSoNames.push_back(name.Data()+6);
+      f.fSoBins = h->GetNbinsX();
+      for(Int_t b = 1; b <= f.fSoBins; b++)
+        f.fSo.push_back(h->GetBinContent(b));
+    }
+    delete h;
+  }
+  delete file;
+};
+
+//____________________________________________________________________
+TChain* ChainBuilder::MakeChain(TChain *chain)
+{
+  if(!chain)
+    chain = new TChain(fTreeName);
+  for(auto i : fGood)
+    chain->Add(fFiles[i].fPath.c_str(), fFiles[i].fEntries);
+
+  return chain;
+};
+
+//____________________________________________________________________
+Long64_t ChainBuilder::GetTotalEntries()
+{
+  Long64_t n = 0;
+  for(auto i : fGood)
+    n += fFiles[i].fEntries;
+
+  return n;
+};
+
+//____________________________________________________________________
+Bool_t ChainBuilder::GetSoDistributions(TH1D **hEvSo, const char **names, Int_t n)
+{
+  Bool_t found = kTRUE;
+  for(UInt_t iF = 0; iF < fGood.size() && found; iF++) {
+    const File &f = fFiles[fGood[iF]];
+    for(Int_t i = 0; i < n && found; i++) {
+      auto it = std::find(f.fSoNames.begin(), f.fSoNames.end(), names[i]);
+      if(it == f.fSoNames.end() || hEvSo[i]->GetNbinsX() != f.fSoBins) {
+        found = kFALSE;
+        break;
+      }
+      const Double_t *content = &f.fSo[(it - f.fSoNames.begin())*f.fSoBins];
+      for(Int_t b = 0; b < f.fSoBins; b++)
+        hEvSo[i]->AddBinContent(b+1, content[b]);
+    }
+  }
+
+  for(Int_t i = 0; i < n; i++) {
+    if(found)
+      hEvSo[i]->SetEntries(hEvSo[i]->Integral());
+    else
+      hEvSo[i]->Reset();
+  }
+  return found;
+};
+
+//____________________________________________________________________
+void ChainBuilder::ReadManifest(std::map<std::string, File> &known)
+{
+  if(gSystem->AccessPathName(fManifest))
+    return;
+
+  TDirectory::TContext context;
+  TFile *file = TFile::Open(fManifest);
+  TTree *tree = file ? (TTree*)file->Get("manifest") : 0;
+  if(!tree) {
+    Warning("ReadManifest", "no manifest in %s, all files are opened", fManifest.Data());
+    delete file;
+    return;
+  }
+
+  Char_t path[4096], soNames[1024];
+  Long64_t size, mtime, entries;
+  Bool_t good;
+  Int_t soBins, nSo;
+  std::vector<Double_t> so(TMath::Max(1, (Int_t)tree->GetMaximum("nSo")));
+  tree->SetBranchAddress("path", path);
+  tree->SetBranchAddress("size", &size);
+  tree->SetBranchAddress("mtime", &mtime);
+  tree->SetBranchAddress("entries", &entries);
+  tree->SetBranchAddress("good", &good);
+  tree->SetBranchAddress("soNames", soNames);
+  tree->SetBranchAddress("soBins", &soBins);
+  tree->SetBranchAddress("nSo", &nSo);
+  tree->SetBranchAddress("so", so.data());
+
+  for(Long64_t i = 0; i < tree->GetEntries(); i++) {
+    tree->GetEntry(i);
+    File f;
+    f.fPath = path;
+    f.fSize = size;
+    f.fMtime = mtime;
+    f.fEntries = entries;
+    f.fGood = good;
+    std::istringstream names(soNames);
+    std::string name;
+    while(std::getline(names, name, ','))
+      f.fSoNames.push_back(name);
+    f.fSoBins = soBins;
+    f.fSo.assign(so.begin(), so.begin() + nSo);
+    known[f.fPath] = f;
+  }
+  delete file;
+};
+
+//____________________________________________________________________
+void ChainBuilder::WriteManifest()
+{
+  // written next to the final name and renamed, a run reading it never sees half a file
+  TDirectory::TContext context;
+  TString tmpName = fManifest + ".tmp";
+  TFile *file = TFile::Open(tmpName, "RECREATE");
+  if(!file || file->IsZombie()) {
+    Warning("WriteManifest", "cannot write %s", tmpName.Data());
+    delete file;
+    return;
+  }
+
+  Char_t path[4096], soNames[1024];
+  Long64_t size, mtime, entries;
+  Bool_t good;
+  Int_t soBins, nSo;
+  size_t maxSo = 1;
+  for(auto &f : fFiles)
+    maxSo = std::max(maxSo, f.fSo.size());
+  std::vector<Double_t> so(maxSo);
+
+  TTree *tree = new TTree("manifest", Form("files of the %s chain", fTreeName.Data()));
+  tree->Branch("path", path, "path/C");
+  tree->Branch("size", &size, "size/L");
+  tree->Branch("mtime", &mtime, "mtime/L");
+  tree->Branch("entries", &entries, "entries/L");
+  tree->Branch("good", &good, "good/O");
+  tree->Branch("soNames", soNames, "soNames/C");
+  tree->Branch("soBins", &soBins, "soBins/I");
+  tree->Branch("nSo", &nSo, "nSo/I");
+  tree->Branch("so", so.data(), "so[nSo]/D");
+
+  for(auto &f : fFiles) {
+    strncpy(path, f.fPath.c_str(), sizeof(path)-1);
+    path[sizeof(path)-1] = 0;
+    size = f.fSize;
+    mtime = f.fMtime;
+    entries = f.fEntries;
+    good = f.fGood;
+    std::string names;
+    for(auto &name : f.fSoNames)
+      names += (names.empty() ? "" : ",") + name;
+    strncpy(soNames, names.c_str(), sizeof(soNames)-1);
+    soNames[sizeof(soNames)-1] = 0;
+    soBins = f.fSoBins;
+    nSo = f.fSo.size();
+    std::copy(f.fSo.begin(), f.fSo.end(), so.begin());
+    tree->Fill();
+  }
+
+  file->Write();
+  delete file;
+  if(gSystem->Rename(tmpName, fManifest))
+    Warning("WriteManifest", "cannot rename %s to %s", tmpName.Data(), fManifest.Data());
+};
@@ -0,0 +1,68 @@
+#ifndef CHAINBUILDER__H
+#define CHAINBUILDER__H
+
+#include "TNamed.h"
+#include "TString.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+class TChain;
+class TH1D;
+
+// Builds the reading chain from a file list (.list) or a single .root file.
+// The files are opened in parallel to check them and to record their entries
+// and the spherocity distributions (hEvSo_*) saved by makeTreeSoRt. The
+// records go to a manifest, <list>.manifest.root by default, and later runs
+// only reopen files whose size or modification time changed. MakeChain()
+// adds the files with their known entries, so TChain does not open them.
+class ChainBuilder : public TNamed {
+ public:
+  ChainBuilder(const char *treeName = "tree");
+  ~ChainBuilder() {}
+
+  void SetNThreads(Int_t n) { fNThreads = n; } // 0: all cores
+  void SetManifest(const char *path) { fManifest = path; fManifestSet = kTRUE; } // "" for none
+
+  Bool_t Build(const char *input); // false if there is no good file
+  TChain* MakeChain(TChain *chain = 0);
+
+  Int_t GetNFiles() { return fGood.size(); }
+  const char* GetFile(Int_t i) { return fFiles[fGood[i]].fPath.c_str(); }
+  Long64_t GetEntries(Int_t i) { return fFiles[fGood[i]].fEntries; }
+  Long64_t GetTotalEntries();
+  Int_t GetNOpened() { return fNOpened; } // files opened by the last Build()
+
+  // sum of hEvSo_<names[i]> over the good files, false if a file has none
+  Bool_t GetSoDistributions(TH1D **hEvSo, const char **names, Int_t n);
+
+ private:
+
+  struct File {
+    std::string fPath;
+    Long64_t fSize;
+    Long64_t fMtime;
+    Long64_t fEntries;
+    Bool_t   fGood;
+    std::vector<std::string> fSoNames;
+    Int_t    fSoBins;
+    std::vector<Double_t> fSo; // contents of the fSoNames histograms without under/overflow, one after the other
+  };
+
+  void Check(File &file);
+  void ReadManifest(std::map<std::string, File> &known);
+  void WriteManifest();
+
+  TString fTreeName;
+  Int_t   fNThreads;
+  TString fManifest;
+  Bool_t  fManifestSet;
+  Int_t   fNOpened;
+  std::vector<File>  fFiles; //! in the order of the list
+  std::vector<Int_t> fGood;  //! indices of the good files
+
+  ClassDef(ChainBuilder, 1);
+};
+
+#endif
@@ -0,0 +1,164 @@
+#include "DPhiCorrelator.h"
+
+#include "TMath.h"
+
+#include <algorithm>
+
+ClassImp(DPhiCorrelator)
+
+DPhiCorrelator::DPhiCorrelator(Int_t nSlots, Int_t nPhiBins):
+  fNbins(nPhiBins),
+  fNtrig(0),
+  fTrig(nPhiBins, 0.),
+  fAssoc(nPhiBins, 0.),
+  fZ(nPhiBins),
+  fCross(nPhiBins),
+  fSum(nSlots, std::vector<std::complex<Double_t> >(nPhiBins)),
+  fSelf(nSlots, 0.)
+{
+  if(nPhiBins < 2 || (nPhiBins & (nPhiBins-1)))
+    Fatal("DPhiCorrelator", "the number of phi bins (%i) must be a power of 2", nPhiBins);
+};
+
+//____________________________________________________________________
+void DPhiCorrelator::Reset() 
+{
+  fNtrig = 0;
+  std::fill(fTrig.begin(), fTrig.end(), 0.);
+  std::fill(fAssoc.begin(), fAssoc.end(), 0.);
+};
+
+//____________________________________________________________________
+void DPhiCorrelator::AddTrack(Double_t phi, Bool_t isTrigger) 
+{
+  Double_t x = phi/TMath::TwoPi();
+  x -= TMath::Floor(x);
+  Int_t bin = (Int_t)(x*fNbins);
+  if(bin >= fNbins) bin = 0; // x just below 1 rounding up
+
+  fAssoc[bin] += 1;
+  if(isTrigger) {
+    fTrig[bin] += 1;
+    fNtrig++;
+  }
+};
+
+//____________________________________________________________________
+void DPhiCorrelator::Transform() 
+{
+  // both real histograms in one complex FFT: z = trig + i*assoc
+  for(Int_t n = 0; n < fNbins; n++)
+    fZ[n] = std::complex<Double_t>(fTrig[n], fAssoc[n]);
+  FFT(fZ, kFALSE);
+
+  for(Int_t k = 0; k < fNbins; k++) {
+    std::complex<Double_t> zk = fZ[k];
+    std::complex<Double_t> zm = std::conj(fZ[(fNbins-k) & (fNbins-1)]);
+    std::complex<Double_t> trig = 0.5*(zk + zm);
+    std::complex<Double_t> assoc = std::complex<Double_t>(0., -0.5)*(zk - zm);
+    fCross[k] = std::conj(trig)*assoc;
+  }
+};
+
+//____________________________________________________________________
+void DPhiCorrelator::Accumulate(Int_t slot) 
+{
+  std::vector<std::complex<Double_t> > &sum = fSum[slot];
+  for(Int_t k = 0; k < fNbins; k++)
+    sum[k] += fCross[k];
+  fSelf[slot] += fNtrig;
+};
+
+//____________________________________________________________________
+void DPhiCorrelator::Add(const DPhiCorrelator &other) 
+{
+  if(other.fNbins != fNbins || other.fSum.size() != fSum.size()) {
+    Error("Add", "binning or number of slots differ");
+    return;
+  }
+
+  for(UInt_t slot = 0; slot < fSum.size(); slot++) {
+    for(Int_t k = 0; k < fNbins; k++)
+      fSum[slot][k] += other.fSum[slot][k];
+    fSelf[slot] += other.fSelf[slot];
+  }
+};
+
+//____________________________________________________________________
+void DPhiCorrelator::Fill(Int_t slot, TH1 *h) 
+{
+  fZ = fSum[slot];
+  FFT(fZ, kTRUE);
+
+  // lag l counts pairs with phi(assoc) - phi(trig) in l*w +- w with a triangular
+  // distribution, spread over the four quarters of that range
+  const Double_t w = TMath::TwoPi()/fNbins;
+  const Double_t quarter[4] = { 1./8, 3./8, 3./8, 1./8 };
+  for(Int_t l = 0; l < fNbins; l++) {
+    Double_t pairs = fZ[l].real()/fNbins;
+    if(l == 0)
+      pairs -= fSelf[slot];
+    if(TMath::Abs(pairs) < 0.5) // rounding noise of empty lags
+      continue;
+    Int_t lag = (l < fNbins/2) ? l : l - fNbins;
+    for(Int_t q = 0; q < 4; q++)
+      FillInterval(h, (lag-1+0.5*q)*w, (lag-0.5+0.5*q)*w, quarter[q]*pairs);
+  }
+};
+
+//____________________________________________________________________
+void DPhiCorrelator::FillInterval(TH1 *h, Double_t lo, Double_t hi, Double_t weight) 
+{
+  // intervals reaching beyond +-pi are wrapped
+  if(hi <= -TMath::Pi()) { lo += TMath::TwoPi(); hi += TMath::TwoPi(); }
+  if(lo >= TMath::Pi()) { lo -= TMath::TwoPi(); hi -= TMath::TwoPi(); }
+  if(lo < -TMath::Pi()) {
+    Double_t f = (-TMath::Pi() - lo)/(hi - lo);
+    FillInterval(h, lo + TMath::TwoPi(), TMath::Pi(), f*weight);
+    FillInterval(h, -TMath::Pi(), hi, (1-f)*weight);
+    return;
+  }
+  if(hi > TMath::Pi()) {
+    Double_t f = (hi - TMath::Pi())/(hi - lo);
+    FillInterval(h, -TMath::Pi(), hi - TMath::TwoPi(), f*weight);
+    FillInterval(h, lo, TMath::Pi(), (1-f)*weight);
+    return;
+  }
+
+  TAxis *axis = h->GetXaxis();
+  for(Int_t bin = axis->FindFixBin(lo); bin <= axis->FindFixBin(hi); bin++) {
+    Double_t overlap = TMath::Min(hi, axis->GetBinUpEdge(bin)) - TMath::Max(lo, axis->GetBinLowEdge(bin));
+    if(overlap > 0)
+      h->Fill(axis->GetBinCenter(bin), weight*overlap/(hi - lo));
+  }
+};
+
+//____________________________________________________________________
+void DPhiCorrelator::FFT(std::vector<std::complex<Double_t> > &z, Bool_t inverse) 
+{
+  // iterative radix-2, unnormalised
+  const Int_t n = z.size();
+  for(Int_t i = 1, j = 0; i < n; i++) {
+    Int_t bit = n >> 1;
+    for(; j & bit; bit >>= 1)
+      j ^= bit;
+    j ^= bit;
+    if(i < j)
+      std::swap(z[i], z[j]);
+  }
+
+  for(Int_t len = 2; len <= n; len <<= 1) {
+    Double_t angle = (inverse ? 1 : -1)*TMath::TwoPi()/len;
+    std::complex<Double_t> wlen(TMath::Cos(angle), TMath::Sin(angle));
+    for(Int_t i = 0; i < n; i += len) {
+      std::complex<Double_t> w(1.);
+      for(Int_t j = 0; j < len/2; j++) {
+        std::complex<Double_t> u = z[i+j];
+        std::complex<Double_t> v = z[i+j+len/2]*w;
+        z[i+j] = u + v;
+        z[i+j+len/2] = u - v;
+        w *= wlen;
+      }
+    }
+  }
+};
@@ -0,0 +1,46 @@
+#ifndef DPHICORRELATOR__H
+#define DPHICORRELATOR__H
+
+#include "TNamed.h"
+#include "TH1.h"
+
+#include <complex>
+#include <vector>
+
+// Delta phi distribution of track pairs without a pair loop. The tracks of an
+// event are histogrammed in phi (trigger tracks and all tracks separately) and
+// the pair distribution is the circular cross-correlation of the two
+// histograms. It is accumulated in Fourier space, so an event costs O(N) for
+// the histograms plus one FFT, and it is transformed back only in Fill().
+// Slots hold independent distributions, e.g. one per estimator and class.
+// Pairs are ordered, phi(assoc) - phi(trigger), and self pairs are removed.
+class DPhiCorrelator : public TNamed {
+ public:
+  DPhiCorrelator(Int_t nSlots, Int_t nPhiBins = 1024); // nPhiBins must be a power of 2
+  ~DPhiCorrelator() {}
+
+  void Reset();
+  void AddTrack(Double_t phi, Bool_t isTrigger); // every track is an associate
+  void Transform();
+  void Accumulate(Int_t slot);
+  void Add(const DPhiCorrelator &other); // e.g. merging per-thread copies
+  void Fill(Int_t slot, TH1 *h);
+
+ private:
+
+  void FFT(std::vector<std::complex<Double_t> > &z, Bool_t inverse);
+  void FillInterval(TH1 *h, Double_t lo, Double_t hi, Double_t weight);
+
+  Int_t fNbins;
+  Int_t fNtrig;    // trigger tracks in the event, equal to its self pairs
+  std::vector<Double_t> fTrig;  //!
+  std::vector<Double_t> fAssoc; //!
+  std::vector<std::complex<Double_t> > fZ;     //! scratch
+  std::vector<std::complex<Double_t> > fCross; //! cross-spectrum of the event
+  std::vector<std::vector<std::complex<Double_t> > > fSum; //! per slot
+  std::vector<Double_t> fSelf; //! self pairs per slot
+
+  ClassDef(DPhiCorrelator, 1);
+};
+
+#endif
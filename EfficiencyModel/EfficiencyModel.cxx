@@ -0,0 +1,37 @@
+#include "EfficiencyModel.h"
+
+#include "TMath.h"
+
+ClassImp(EfficiencyModel)
+
+EfficiencyModel::EfficiencyModel(Double_t ptMax, Int_t nBins):
+  fPtMax(ptMax),
+  fNbins(nBins),
+  fInvBinWidth(nBins/ptMax),
+  fSpecies(2*kMaxPdg, -1)
+{
+};
+
+//____________________________________________________________________
+Int_t EfficiencyModel::AddSpecies(Int_t pdg, TF1 *f, Bool_t chargeConjugate) 
+{
+  // chargeConjugate = kFALSE matches only the given sign of the PDG code
+  Int_t species = fTable.size();
+  if(TMath::Abs(pdg) < kMaxPdg) {
+    fSpecies[pdg+kMaxPdg] = species;
+    if(chargeConjugate)
+      fSpecies[-pdg+kMaxPdg] = species;
+  }
+  else
+    Warning("AddSpecies", "PDG code %i is out of the lookup range", pdg);
+
+  std::vector<Double_t> table(fNbins+1);
+  for(Int_t i = 0; i <= fNbins; i++) {
+    Double_t eff = f->Eval(i*fPtMax/fNbins);
+    table[i] = TMath::Finite(eff) ? eff : 0.; // e.g. 1/x terms at pT = 0
+  }
+  fTable.push_back(table);
+  fFunc.push_back(f);
+
+  return species;
+};
@@ -0,0 +1,45 @@
+#ifndef EFFICIENCYMODEL__H
+#define EFFICIENCYMODEL__H
+
+#include "TNamed.h"
+#include "TF1.h"
+
+#include <vector>
+
+// Tracking efficiency per particle species. The PDG code is mapped to a
+// species with a direct lookup table and every species' TF1 is tabulated at
+// startup on a fine pT grid that is interpolated linearly, so Eval() costs
+// a couple of loads. The TF1s stay the source of truth (they are what gets
+// written to the output) and are only evaluated beyond the tabulated range.
+class EfficiencyModel : public TNamed {
+ public:
+  EfficiencyModel(Double_t ptMax = 20., Int_t nBins = 10000);
+  ~EfficiencyModel() {}
+
+  Int_t AddSpecies(Int_t pdg, TF1 *f, Bool_t chargeConjugate = kTRUE); // returns the species index
+  Int_t GetSpecies(Int_t pdg) { return (pdg > -kMaxPdg && pdg < kMaxPdg) ? fSpecies[pdg+kMaxPdg] : -1; }
+  Int_t GetNSpecies() { return fTable.size(); }
+  Double_t Eval(Int_t species, Double_t pt) {
+    Double_t x = pt*fInvBinWidth;
+    if(x < 0 || x >= fNbins)
+      return fFunc[species]->Eval(pt);
+    Int_t i = (Int_t)x;
+    const Double_t *t = &fTable[species][i];
+    return t[0] + (x - i)*(t[1] - t[0]);
+  }
+
+ private:
+
+  static const Int_t kMaxPdg = 10000;
+
+  Double_t fPtMax;
+  Int_t    fNbins;
+  Double_t fInvBinWidth;
+  std::vector<Short_t> fSpecies; //! signed PDG code + kMaxPdg -> species
+  std::vector<std::vector<Double_t> > fTable; //! efficiency at the fNbins+1 grid points
+  std::vector<TF1*> fFunc; //! not owned
+
+  ClassDef(EfficiencyModel, 1);
+};
+
+#endif
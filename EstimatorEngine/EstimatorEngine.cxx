@@ -0,0 +1,238 @@
+#include "EstimatorEngine.h"
+#include "../EventKinematics/EventKinematics.h"
+
+#include "TMath.h"
+#include "TTree.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+ClassImp(EstimatorEngine)
+
+EstimatorEngine::EstimatorEngine()
+{
+};
+
+//____________________________________________________________________
+Int_t EstimatorEngine::AddEstimator(const char *definition) 
+{
+  std::istringstream words(definition);
+  std::string name, quantity, option;
+  if(!(words >> name >> quantity)) {
+    Error("AddEstimator", "\"%s\" needs at least a name and count or sumpt", definition);
+    return -1;
+  }
+  if(FindEstimator(name.c_str()) >= 0) {
+    Error("AddEstimator", "there is already an estimator %s", name.c_str());
+    return -1;
+  }
+
+  Estimator e;
+  e.fName = name.c_str();
+  if(quantity == "count") e.fQuantity = kCount;
+  else if(quantity == "sumpt") e.fQuantity = kSumPt;
+  else {
+    Error("AddEstimator", "%s: unknown quantity %s", name.c_str(), quantity.c_str());
+    return -1;
+  }
+  e.fLead = -1;
+  e.fLeadPtMin = 0.;
+  e.fAllOf = EventKinematics::kChargedFinalHadron;
+  e.fAnyEta = 0;
+  e.fAnyRegion = 0;
+  Int_t lead = kLeadGen;
+  Bool_t hasLeadPt = kFALSE;
+
+  while(words >> option) {
+    size_t eq = option.find('=');
+    std::string key = option.substr(0, eq);
+    std::string value = (eq == std::string::npos) ? "" : option.substr(eq+1);
+    std::istringstream items(value);
+    std::string item;
+
+    if(key == "select") {
+      e.fAllOf = 0;
+      while(std::getline(items, item, ',')) {
+        if(item == "final") e.fAllOf |= EventKinematics::kFinal;
+        else if(item == "hadron") e.fAllOf |= EventKinematics::kHadron;
+        else if(item == "charged") e.fAllOf |= EventKinematics::kCharged;
+        else if(item == "reco") e.fAllOf |= EventKinematics::kReco;
+        else {
+          Error("AddEstimator", "%s: unknown selection %s", name.c_str(), item.c_str());
+          return -1;
+        }
+      }
+    }
+    else if(key == "eta") {
+      while(std::getline(items, item, ',')) {
+        Double_t min, max;
+        if(sscanf(item.c_str(), "%lf:%lf", &min, &max) != 2 || min >= max) {
+          Error("AddEstimator", "%s: bad eta window %s", name.c_str(), item.c_str());
+          return -1;
+        }
+        Int_t w = EtaWindow(min, max);
+        if(w < 0)
+          return -1;
+        e.fAnyEta |= 1ULL << (kEtaShift + w);
+      }
+    }
+    else if(key == "region") {
+      while(std::getline(items, item, '+')) {
+        if(item == "toward") e.fAnyRegion |= kToward;
+        else if(item == "away") e.fAnyRegion |= kAway;
+        else if(item == "trans") e.fAnyRegion |= kTrans;
+        else if(item == "all") e.fAnyRegion |= kAllRegions;
+        else {
+          Error("AddEstimator", "%s: unknown region %s", name.c_str(), item.c_str());
+          return -1;
+        }
+      }
+    }
+    else if(key == "lead" && (value == "gen" || value == "rec"))
+      lead = (value == "gen") ? kLeadGen : kLeadRec;
+    else if(key == "leadpt") {
+      hasLeadPt = kTRUE;
+      e.fLeadPtMin = atof(value.c_str());
+    }
+    else {
+      Error("AddEstimator", "%s: unknown option %s", name.c_str(), option.c_str());
+      return -1;
+    }
+  }
+
+  // regions need a leading particle, without one (pT <= leadpt) the estimator is -1
+  Bool_t hasRegion = e.fAnyRegion && e.fAnyRegion != kAllRegions;
+  if(hasRegion || hasLeadPt)
+    e.fLead = lead;
+  if(hasRegion)
+    e.fAnyRegion <<= kRegionShift + 3*lead;
+  else
+    e.fAnyRegion = 1ULL << kAlways;
+  if(!e.fAnyEta)
+    e.fAnyEta = 1ULL << kAlways;
+
+  fEstimators.push_back(e);
+  return fEstimators.size()-1;
+};
+
+//____________________________________________________________________
+Bool_t EstimatorEngine::ReadConfig(const char *fileName) 
+{
+  std::ifstream in(fileName);
+  if(!in) {
+    Error("ReadConfig", "cannot open %s", fileName);
+    return kFALSE;
+  }
+
+  std::string line;
+  while(std::getline(in, line)) {
+    line = line.substr(0, line.find('#'));
+    if(line.find_first_not_of(" \t") == std::string::npos)
+      continue;
+    if(AddEstimator(line.c_str()) < 0)
+      return kFALSE;
+  }
+
+  return kTRUE;
+};
+
+//____________________________________________________________________
+Int_t EstimatorEngine::FindEstimator(const char *name) 
+{
+  for(UInt_t i = 0; i < fEstimators.size(); i++)
+    if(fEstimators[i].fName == name)
+      return i;
+
+  return -1;
+};
+
+//____________________________________________________________________
+Int_t EstimatorEngine::EtaWindow(Double_t min, Double_t max) 
+{
+  // estimators share the bit of identical windows
+  for(UInt_t i = 0; i < fEtaMin.size(); i++)
+    if(fEtaMin[i] == min && fEtaMax[i] == max)
+      return i;
+
+  if(fEtaMin.size() >= kMaxEtaWindows) {
+    Error("EtaWindow", "more than %i different eta windows", kMaxEtaWindows);
+    return -1;
+  }
+  fEtaMin.push_back(min);
+  fEtaMax.push_back(max);
+  return fEtaMin.size()-1;
+};
+
+//____________________________________________________________________
+void EstimatorEngine::MakeBranches(TTree *tree) 
+{
+  // the value vectors must not move once the branches point at them
+  fCounts.assign(fEstimators.size(), -1);
+  fSums.assign(fEstimators.size(), -1);
+  for(UInt_t i = 0; i < fEstimators.size(); i++) {
+    const char *name = fEstimators[i].fName.Data();
+    if(fEstimators[i].fQuantity == kCount)
+      tree->Branch(name, &fCounts[i], Form("%s/I", name));
+    else
+      tree->Branch(name, &fSums[i], Form("%s/F", name));
+  }
+};
+
+//____________________________________________________________________
+void EstimatorEngine::Compute(Int_t n, const Double_t *pt, const Double_t *eta, const Double_t *phi, const UChar_t *flags,
+                              const Double_t *leadPt, const Double_t *leadPhi) 
+{
+  if(fCounts.size() != fEstimators.size()) {
+    fCounts.assign(fEstimators.size(), -1);
+    fSums.assign(fEstimators.size(), -1);
+  }
+  if((Int_t)fWords.size() < n)
+    fWords.resize(n);
+  ULong64_t *words = fWords.data();
+
+  for(Int_t i = 0; i < n; i++)
+    words[i] = flags[i] | (1ULL << kAlways);
+
+  // eta windows, one bit each
+  for(UInt_t w = 0; w < fEtaMin.size(); w++) {
+    const Double_t min = fEtaMin[w], max = fEtaMax[w];
+    for(Int_t i = 0; i < n; i++)
+      words[i] |= ULong64_t(eta[i] > min && eta[i] < max) << (kEtaShift + w);
+  }
+
+  // azimuthal region to the leading particles, as |DeltaPhi| against pi/3 and 2pi/3
+  const Double_t pi = TMath::Pi(), piThird = TMath::Pi()/3., twoPiThird = 2.*TMath::Pi()/3.;
+  for(Int_t l = 0; l < kNLeads; l++) {
+    const Double_t lp = leadPhi[l];
+    const Int_t shift = kRegionShift + 3*l;
+    for(Int_t i = 0; i < n; i++) {
+      Double_t dphi = TMath::Abs(phi[i] - lp);
+      dphi = (dphi > pi) ? 2*pi - dphi : dphi;
+      ULong64_t region = (dphi < piThird) ? kToward : ((dphi > twoPiThird) ? kAway : kTrans);
+      words[i] |= region << shift;
+    }
+  }
+
+  for(UInt_t e = 0; e < fEstimators.size(); e++) {
+    const Estimator &est = fEstimators[e];
+    if(est.fLead >= 0 && !(leadPt[est.fLead] > est.fLeadPtMin)) {
+      fCounts[e] = -1;
+      fSums[e] = -1;
+      continue;
+    }
+    const ULong64_t allOf = est.fAllOf, anyEta = est.fAnyEta, anyRegion = est.fAnyRegion;
+    Int_t count = 0;
+    Double_t sum = 0;
+    for(Int_t i = 0; i < n; i++) {
+      const ULong64_t w = words[i];
+      const Bool_t pass = ((w & allOf) == allOf) & ((w & anyEta) != 0) & ((w & anyRegion) != 0);
+      count += pass;
+      sum += pass ? pt[i] : 0.;
+    }
+    fCounts[e] = count;
+    fSums[e] = sum;
+  }
+};
@@ -0,0 +1,70 @@
+#ifndef ESTIMATORENGINE__H
+#define ESTIMATORENGINE__H
+
+#include "TNamed.h"
+
+#include <vector>
+
+class TTree;
+
+// Event estimators (multiplicities, summed pT) defined by a line each:
+//
+//   name count|sumpt [select=final,hadron,charged,reco] [eta=min:max,min:max...]
+//        [region=toward+away+trans] [lead=gen|rec] [leadpt=X]
+//
+// select are the EventKinematics flags all required (default final,hadron,charged),
+// eta the open windows of which any must hold, region the azimuthal region(s)
+// relative to the leading particle (toward |dphi| < pi/3, away > 2pi/3,
+// transverse in between). Estimators with leadpt give -1 unless the leading
+// particle is above it. The definitions are compiled into bit masks: one pass
+// over the event sets a bit word per particle (flags, eta windows, regions)
+// and every estimator is then a branch-free mask test over these words.
+class EstimatorEngine : public TNamed {
+ public:
+  enum EQuantity { kCount, kSumPt };
+  enum ERegion { kToward = BIT(0), kAway = BIT(1), kTrans = BIT(2), kAllRegions = kToward|kAway|kTrans };
+  enum ELead { kLeadGen, kLeadRec, kNLeads };
+  enum { kMaxEtaWindows = 32 };
+
+  EstimatorEngine();
+  ~EstimatorEngine() {}
+
+  Int_t AddEstimator(const char *definition);
+  Bool_t ReadConfig(const char *fileName); // one definition per line, # comments
+  Int_t GetNEstimators() { return fEstimators.size(); }
+  const char* GetEstimatorName(Int_t i) { return fEstimators[i].fName.Data(); }
+  Int_t FindEstimator(const char *name);
+
+  void MakeBranches(TTree *tree); // name/I for counts, name/F for summed pT
+  void Compute(Int_t n, const Double_t *pt, const Double_t *eta, const Double_t *phi, const UChar_t *flags,
+               const Double_t *leadPt, const Double_t *leadPhi);
+  Double_t GetValue(Int_t i) { return fEstimators[i].fQuantity == kCount ? fCounts[i] : fSums[i]; }
+
+ private:
+  // bit word per particle: flags 0-7, regions to the gen/rec leading particle 8-10/11-13,
+  // eta windows from 16, bit 63 always set
+  enum { kRegionShift = 8, kEtaShift = 16, kAlways = 63 };
+
+  struct Estimator {
+    TString   fName;
+    Int_t     fQuantity;
+    Int_t     fLead;
+    Double_t  fLeadPtMin;
+    ULong64_t fAllOf;      // flags, all required
+    ULong64_t fAnyEta;     // eta window bits, any
+    ULong64_t fAnyRegion;  // region bits, any
+  };
+
+  Int_t EtaWindow(Double_t min, Double_t max);
+
+  std::vector<Estimator> fEstimators; //!
+  std::vector<Double_t>  fEtaMin;     //! distinct eta windows
+  std::vector<Double_t>  fEtaMax;     //!
+  std::vector<ULong64_t> fWords;      //! per particle
+  std::vector<Int_t>     fCounts;     //! per estimator, branch addresses
+  std::vector<Float_t>   fSums;       //!
+
+  ClassDef(EstimatorEngine, 1);
+};
+
+#endif
@@ -0,0 +1,43 @@
+#include "EventKinematics.h"
+
+#include "TMath.h"
+
+ClassImp(EventKinematics)
+
+EventKinematics::EventKinematics():
+  fN(0)
+{
+};
+
+//____________________________________________________________________
+void EventKinematics::Reset(Int_t n)
+{
+  // only grows, the arrays are reused from event to event
+  fN = n;
+  if(Int_t(fPx.size()) >= n)
+    return;
+  fPx.resize(n); fPy.resize(n); fPz.resize(n);
+  fPt.resize(n); fEta.resize(n); fAbsEta.resize(n); fPhi.resize(n);
+  fPdg.resize(n); fCharge3.resize(n); fFlags.resize(n);
+}
+
+//____________________________________________________________________
+void EventKinematics::Compute()
+{
+  const Double_t *px = fPx.data(), *py = fPy.data(), *pz = fPz.data();
+  Double_t *pt = fPt.data(), *eta = fEta.data(), *absEta = fAbsEta.data(), *phi = fPhi.data();
+
+  for(Int_t i = 0; i < fN; i++)
+    pt[i] = TMath::Sqrt(px[i]*px[i] + py[i]*py[i]);
+
+  // as Pythia8::Vec4::eta(), protected against pT = 0
+  for(Int_t i = 0; i < fN; i++) {
+    Double_t pt2 = px[i]*px[i] + py[i]*py[i];
+    absEta[i] = TMath::Log((TMath::Sqrt(pt2 + pz[i]*pz[i]) + TMath::Abs(pz[i])) / TMath::Sqrt(TMath::Max(1e-20, pt2)));
+  }
+  for(Int_t i = 0; i < fN; i++)
+    eta[i] = pz[i] > 0. ? absEta[i] : -absEta[i];
+
+  for(Int_t i = 0; i < fN; i++)
+    phi[i] = TMath::ATan2(py[i], px[i]);
+}
@@ -0,0 +1,61 @@
+#ifndef EVENTKINEMATICS__H
+#define EVENTKINEMATICS__H
+
+#include "TNamed.h"
+
+#include <vector>
+
+// Per-event kinematics cache in structure-of-arrays layout. The generator
+// copies momenta, PDG codes, charges and status bits of all particles in the event
+// with Set(), then Compute() derives pT, eta and phi in separate tight
+// loops over the arrays. The selections afterwards only load and compare.
+// Eta follows the Pythia definition (+-log of (p+|pz|)/pT).
+class EventKinematics : public TNamed {
+ public:
+  enum { kFinal = BIT(0), kHadron = BIT(1), kCharged = BIT(2), kReco = BIT(3),
+         kChargedFinalHadron = kFinal|kHadron|kCharged };
+
+  EventKinematics();
+  ~EventKinematics() {}
+
+  void Reset(Int_t n);
+  void Set(Int_t i, Double_t px, Double_t py, Double_t pz, Int_t pdg, Int_t charge3, UChar_t flags) {
+    fPx[i] = px; fPy[i] = py; fPz[i] = pz; fPdg[i] = pdg; fCharge3[i] = charge3; fFlags[i] = flags;
+  }
+  void SetReco(Int_t i, Bool_t isReco) { if(isReco) fFlags[i] |= kReco; else fFlags[i] &= ~kReco; }
+  void Compute();
+
+  Int_t    GetN() { return fN; }
+  Double_t Px(Int_t i) { return fPx[i]; }
+  Double_t Py(Int_t i) { return fPy[i]; }
+  Double_t Pt(Int_t i) { return fPt[i]; }
+  Double_t Eta(Int_t i) { return fEta[i]; }
+  Double_t AbsEta(Int_t i) { return fAbsEta[i]; }
+  Double_t Phi(Int_t i) { return fPhi[i]; }
+  Int_t    Pdg(Int_t i) { return fPdg[i]; }
+  Int_t    Charge3(Int_t i) { return fCharge3[i]; }
+  UChar_t  Flags(Int_t i) { return fFlags[i]; }
+  Bool_t   Is(Int_t i, UChar_t mask) { return (fFlags[i] & mask) == mask; }
+
+  const Double_t* GetPt() { return fPt.data(); }
+  const Double_t* GetEta() { return fEta.data(); }
+  const Double_t* GetPhi() { return fPhi.data(); }
+  const UChar_t*  GetFlags() { return fFlags.data(); }
+
+ private:
+  Int_t fN;
+  std::vector<Double_t> fPx;      //!
+  std::vector<Double_t> fPy;      //!
+  std::vector<Double_t> fPz;      //!
+  std::vector<Double_t> fPt;      //!
+  std::vector<Double_t> fEta;     //!
+  std::vector<Double_t> fAbsEta;  //!
+  std::vector<Double_t> fPhi;     //!
+  std::vector<Int_t>    fPdg;     //!
+  std::vector<Char_t>   fCharge3; //! charge in units of e/3
+  std::vector<UChar_t>  fFlags;   //!
+
+  ClassDef(EventKinematics, 1);
+};
+
+#endif
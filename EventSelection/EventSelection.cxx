@@ -0,0 +1,61 @@
+#include "EventSelection.h"
+
+#include "TTree.h"
+#include "TChain.h"
+#include "TChainElement.h"
+#include "TFile.h"
+#include "TDirectory.h"
+#include "TEntryList.h"
+#include "TROOT.h"
+
+ClassImp(EventSelection)
+
+EventSelection::EventSelection(const char* name):
+  TNamed(name, "Event selection"),
+  fCut("")
+{
+};
+
+//____________________________________________________________________
+void EventSelection::AddCut(const char* cut)
+{
+  if(fCut.Length()) fCut += " && ";
+  fCut += Form("(%s)", cut);
+}
+
+//____________________________________________________________________
+TEntryList* EventSelection::Select(TTree* events, Long64_t nEntries)
+{
+  // entries of events (a TTree or a TChain) passing all cuts, among the first nEntries (-1: all)
+  if(nEntries < 0) nEntries = TTree::kMaxEntries;
+
+  TDirectory* dir = gDirectory;
+  gROOT->cd();
+  TString listName = Form("%s_list", GetName());
+  events->Draw(Form(">>%s", listName.Data()), fCut, "entrylist goff", nEntries);
+  TEntryList* list = (TEntryList*)gROOT->FindObject(listName);
+  if(list) list->SetDirectory(0);
+  dir->cd();
+
+  if(!list)
+    Error("Select", "Could not select events with %s", fCut.Data());
+  return list;
+}
+
+//____________________________________________________________________
+TChain* EventSelection::MakeEventChain(TChain* tracks)
+{
+  // chain of the event summary trees of the files in tracks, with tracks as a friend;
+  // files written before the split have the event branches in the track tree itself
+  TFile* ftmp = tracks->GetFile();
+  if(!ftmp || !ftmp->Get("events"))
+    return tracks;
+
+  // aligned by entry, so the entries known for the tracks hold for the events
+  TChain* events = new TChain("events");
+  TIter next(tracks->GetListOfFiles());
+  while(TChainElement* element = (TChainElement*)next())
+    events->Add(element->GetTitle(), element->GetEntries());
+  events->AddFriend(tracks);
+  return events;
+}
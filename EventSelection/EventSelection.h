@@ -0,0 +1,35 @@
+#ifndef EVENTSELECTION__H
+#define EVENTSELECTION__H
+
+#include "TNamed.h"
+#include "TString.h"
+
+class TTree;
+class TChain;
+class TEntryList;
+
+// Event-level preselection on the event summary tree written by
+// makeTreeSoRt ("events", aligned by entry with the track tree "tree").
+// The cuts are TTreeFormula expressions on the ev* branches, Select() only
+// reads those branches and returns the passing entries as a TEntryList,
+// so the track branches are read afterwards only for selected events.
+class EventSelection : public TNamed {
+ public:
+  EventSelection(const char* name = "EventSelection");
+  ~EventSelection() {}
+
+  void AddCut(const char* cut);
+  void ClearCuts() { fCut = ""; }
+  const char* GetCut() const { return fCut.Data(); }
+
+  TEntryList* Select(TTree* events, Long64_t nEntries = -1);
+
+  static TChain* MakeEventChain(TChain* tracks);
+
+ private:
+  TString fCut;		// all cuts joined with &&
+
+  ClassDef(EventSelection, 1);	// Event-level preselection into a TEntryList
+};
+
+#endif
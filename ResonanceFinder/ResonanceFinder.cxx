@@ -0,0 +1,144 @@
+#include "ResonanceFinder.h"
+
+#include "TMath.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+ClassImp(ResonanceFinder)
+
+ResonanceFinder::ResonanceFinder()
+{
+};
+
+//____________________________________________________________________
+Int_t ResonanceFinder::AddChannel(Int_t motherPdg, Int_t nDaughters, const Int_t *daughterPdgs) 
+{
+  if(nDaughters < 1 || nDaughters > kMaxDaughters) {
+    Error("AddChannel", "%i daughters for %i, up to %i are supported", nDaughters, motherPdg, kMaxDaughters);
+    return -1;
+  }
+  if(GetChannel(motherPdg) >= 0) {
+    Error("AddChannel", "there is already a channel for %i", motherPdg);
+    return -1;
+  }
+
+  Channel ch;
+  ch.fMother = TMath::Abs(motherPdg);
+  ch.fNDaughters = nDaughters;
+  for(Int_t i = 0; i < nDaughters; i++)
+    ch.fDaughters[i] = TMath::Abs(daughterPdgs[i]);
+  fChannels.push_back(ch);
+
+  return fChannels.size()-1;
+};
+
+//____________________________________________________________________
+Bool_t ResonanceFinder::ReadChannels(const char *fileName) 
+{
+  std::ifstream in(fileName);
+  if(!in) {
+    Error("ReadChannels", "cannot open %s", fileName);
+    return kFALSE;
+  }
+
+  std::string line;
+  Int_t nLine = 0;
+  while(std::getline(in, line)) {
+    nLine++;
+    line = line.substr(0, line.find('#'));
+    if(line.find_first_not_of(" \t\r") == std::string::npos)
+      continue;
+    std::istringstream words(line);
+    Int_t mother, pdgs[kMaxDaughters+1], n = 0;
+    if(!(words >> mother)) {
+      Error("ReadChannels", "%s:%i: not a PDG code: %s", fileName, nLine, line.c_str());
+      return kFALSE;
+    }
+    while(n <= kMaxDaughters && words >> pdgs[n])
+      n++;
+    if(n <= kMaxDaughters && !words.eof()) {
+      Error("ReadChannels", "%s:%i: not a PDG code: %s", fileName, nLine, line.c_str());
+      return kFALSE;
+    }
+    if(AddChannel(mother, n, pdgs) < 0)
+      return kFALSE;
+  }
+
+  if(fChannels.empty()) {
+    Error("ReadChannels", "no decay channels in %s", fileName);
+    return kFALSE;
+  }
+  return kTRUE;
+};
+
+//____________________________________________________________________
+Int_t ResonanceFinder::GetChannel(Int_t pdg) 
+{
+  // only a handful of channels, a linear scan beats any map
+  pdg = TMath::Abs(pdg);
+  for(UInt_t i = 0; i < fChannels.size(); i++)
+    if(fChannels[i].fMother == pdg)
+      return i;
+
+  return -1;
+};
+
+//____________________________________________________________________
+void ResonanceFinder::Reset(Int_t eventSize) 
+{
+  for(UInt_t i = 0; i < fCandidates.size(); i++)
+    fCandidateOf[fCandidates[i].fEvent] = -1;
+  fCandidates.clear();
+
+  if((Int_t)fCandidateOf.size() < eventSize)
+    fCandidateOf.resize(eventSize, -1);
+};
+
+//____________________________________________________________________
+void ResonanceFinder::AddMother(Int_t iEvent, Int_t iSaved, Int_t pdg, Int_t nDecayProducts) 
+{
+  // decays with more products than the channel can never be complete
+  Int_t channel = GetChannel(pdg);
+  if(channel < 0 || nDecayProducts != fChannels[channel].fNDaughters)
+    return;
+
+  Candidate c;
+  c.fChannel = channel;
+  c.fEvent = iEvent;
+  c.fSaved = iSaved;
+  c.fFilled = 0;
+  c.fMismatch = kFALSE;
+  c.fAllReco = kTRUE;
+  fCandidateOf[iEvent] = fCandidates.size();
+  fCandidates.push_back(c);
+};
+
+//____________________________________________________________________
+void ResonanceFinder::AddDaughter(Int_t iMotherEvent, Int_t pdg, Bool_t isReco) 
+{
+  if(iMotherEvent < 0 || iMotherEvent >= (Int_t)fCandidateOf.size() || fCandidateOf[iMotherEvent] < 0)
+    return;
+
+  Candidate &c = fCandidates[fCandidateOf[iMotherEvent]];
+  const Channel &ch = fChannels[c.fChannel];
+  pdg = TMath::Abs(pdg);
+
+  // first free slot of this species
+  for(Int_t i = 0; i < ch.fNDaughters; i++) {
+    if(ch.fDaughters[i] != pdg || (c.fFilled & (1 << i)))
+      continue;
+    c.fFilled |= (1 << i);
+    c.fAllReco = c.fAllReco && isReco;
+    return;
+  }
+  c.fMismatch = kTRUE;
+};
+
+//____________________________________________________________________
+Bool_t ResonanceFinder::IsComplete(Int_t i) 
+{
+  const Candidate &c = fCandidates[i];
+  return !c.fMismatch && c.fFilled == (1 << fChannels[c.fChannel].fNDaughters) - 1;
+};
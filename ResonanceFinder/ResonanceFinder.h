@@ -0,0 +1,60 @@
+#ifndef RESONANCEFINDER__H
+#define RESONANCEFINDER__H
+
+#include "TNamed.h"
+
+#include <vector>
+
+// Resonance reconstruction from a table of decay channels (phi -> K K, ...).
+// During the particle loop the resonances are registered with AddMother()
+// and every particle reports to its mother with AddDaughter(), building the
+// mother -> daughters index on the fly. Afterwards one pass over the
+// candidates gives which decays are complete and whether all daughters were
+// reconstructed. Codes are matched by absolute value.
+class ResonanceFinder : public TNamed {
+ public:
+  enum { kMaxDaughters = 4 };
+
+  ResonanceFinder();
+  ~ResonanceFinder() {}
+
+  Int_t AddChannel(Int_t motherPdg, Int_t nDaughters, const Int_t *daughterPdgs);
+  Int_t AddChannel(Int_t motherPdg, Int_t pdg1, Int_t pdg2) { Int_t d[2] = { pdg1, pdg2 }; return AddChannel(motherPdg, 2, d); }
+  Bool_t ReadChannels(const char *fileName); // lines of "mother daughter1 daughter2 ...", # comments
+  void ClearChannels() { fChannels.clear(); }
+  Int_t GetNChannels() { return fChannels.size(); }
+  Int_t GetChannel(Int_t pdg);
+
+  void Reset(Int_t eventSize);
+  void AddMother(Int_t iEvent, Int_t iSaved, Int_t pdg, Int_t nDecayProducts);
+  void AddDaughter(Int_t iMotherEvent, Int_t pdg, Bool_t isReco);
+
+  Int_t  GetNCandidates() { return fCandidates.size(); }
+  Int_t  GetSavedIndex(Int_t i) { return fCandidates[i].fSaved; }
+  Bool_t IsComplete(Int_t i);   // exactly the daughters of the channel were found
+  Bool_t IsReco(Int_t i) { return fCandidates[i].fAllReco; }
+
+ private:
+
+  struct Channel {
+    Int_t fMother;
+    Int_t fNDaughters;
+    Int_t fDaughters[kMaxDaughters];
+  };
+  struct Candidate {
+    Int_t   fChannel;
+    Int_t   fEvent;
+    Int_t   fSaved;
+    UChar_t fFilled;   // bit per daughter slot of the channel
+    Bool_t  fMismatch; // a daughter that does not belong to the channel
+    Bool_t  fAllReco;
+  };
+
+  std::vector<Channel>   fChannels;   //!
+  std::vector<Candidate> fCandidates; //!
+  std::vector<Int_t>     fCandidateOf; //! event index -> candidate, -1 if none
+
+  ClassDef(ResonanceFinder, 1);
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include "SoRtSpectra.h"
+#include "../EventKinematics/EventKinematics.h"
+#include "../EstimatorEngine/EstimatorEngine.h"
+
+#include "TDirectory.h"
+#include "TH1.h"
+#include "THnSparse.h"
+#include "TMath.h"
+
+ClassImp(SoRtSpectra)
+
+SoRtSpectra::SoRtSpectra(const char *name):
+  AnalysisTask(name, "So/Rt spectra"),
+  fTrans(-2),
+  fHistPt(0)
+{
+  // pi, K, p, K0s, Lambda, Xi, phi as in makeTreeSoRt
+  const Int_t pdgs[] = { 211, 321, 2212, 310, 3122, 3312, 333 };
+  fSpecies.assign(pdgs, pdgs + sizeof(pdgs)/sizeof(Int_t));
+  for(Int_t i = 0; i < 4; i++)
+    fHistSo[i] = 0;
+};
+
+//____________________________________________________________________
+void SoRtSpectra::Init(TDirectory *dir) 
+{
+  TDirectory *save = gDirectory;
+  dir->cd();
+
+  const char *soNames[4] = { "gen", "genNoPt", "rec", "recNoPt" };
+  for(Int_t i = 0; i < 4; i++)
+    fHistSo[i] = new TH1D(Form("hSo_%s", soNames[i]), Form("Spherocity %s;S_{0};events", soNames[i]), 1000, 0., 1.);
+
+  //                  species            pT   So gen  evNchTrans
+  Int_t    bins[4] = { GetNSpecies(),     200,    50,     51 };
+  Double_t min[4]  = { 0,                  0.,    0.,   -1.5 };
+  Double_t max[4]  = { Double_t(GetNSpecies()), 20.,  1.,  49.5 };
+  fHistPt = new THnSparseD("hPtSoRt", "Identified particles;species;p_{T};S_{0} gen;N_{ch} trans", 4, bins, min, max);
+  for(Int_t i = 0; i < GetNSpecies(); i++)
+    fHistPt->GetAxis(0)->SetBinLabel(i+1, Form("%i", fSpecies[i]));
+  fHistPt->Sumw2();
+  dir->Append(fHistPt);
+
+  save->cd();
+};
+
+//____________________________________________________________________
+void SoRtSpectra::Process(const AnalysisEvent &event) 
+{
+  EventKinematics *kin = event.fKin;
+  EstimatorEngine *est = event.fEstimators;
+
+  // the estimators are only known with the first event
+  if(fTrans == -2) {
+    fTrans = est->FindEstimator("evNchTrans");
+    TDirectory *dir = fHistSo[0]->GetDirectory();
+    TDirectory *save = gDirectory;
+    if(dir) dir->cd();
+    for(Int_t i = 0; i < est->GetNEstimators(); i++)
+      fHistEst.push_back(new TH1D(Form("hEst_%s", est->GetEstimatorName(i)), Form("%s;value;events", est->GetEstimatorName(i)),
+                                  201, -1.5, 199.5));
+    save->cd();
+  }
+
+  for(Int_t i = 0; i < 4; i++)
+    if(event.fSo[i] > 0.)
+      fHistSo[i]->Fill(event.fSo[i], event.fWeight);
+  for(UInt_t i = 0; i < fHistEst.size(); i++)
+    fHistEst[i]->Fill(est->GetValue(i), event.fWeight);
+
+  Double_t x[4];
+  x[2] = event.fSo[0];
+  x[3] = (fTrans >= 0) ? est->GetValue(fTrans) : -1;
+  for(Int_t iP = 0; iP < kin->GetN(); iP++) {
+    if(kin->AbsEta(iP) >= 0.8)
+      continue;
+    Int_t pdg = TMath::Abs(kin->Pdg(iP));
+    for(Int_t iS = 0; iS < GetNSpecies(); iS++) {
+      if(pdg != fSpecies[iS])
+        continue;
+      x[0] = iS + 0.5;
+      x[1] = kin->Pt(iP);
+      fHistPt->Fill(x, event.fWeight);
+      break;
+    }
+  }
+};
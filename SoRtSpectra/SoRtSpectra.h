@@ -0,0 +1,36 @@
+#ifndef SORTSPECTRA__H
+#define SORTSPECTRA__H
+
+#include "../AnalysisTask/AnalysisTask.h"
+
+#include <vector>
+
+class TH1D;
+class THnSparse;
+
+// Final distributions straight from the generator: spherocity spectra,
+// every estimator of the event and the pT spectra of identified particles
+// (|eta| < 0.8) vs. spherocity and the transverse multiplicity. The spectra
+// are a THnSparse (species, pT, So gen, evNchTrans), so So and Rt classes
+// can be chosen afterwards, when the quantiles are known.
+class SoRtSpectra : public AnalysisTask {
+ public:
+  SoRtSpectra(const char *name = "SoRtSpectra");
+  ~SoRtSpectra() {}
+
+  void Init(TDirectory *dir);
+  void Process(const AnalysisEvent &event);
+
+  Int_t GetNSpecies() { return fSpecies.size(); }
+
+ private:
+  std::vector<Int_t> fSpecies;  //! absolute PDG codes
+  Int_t fTrans;                 //! index of evNchTrans, -1 if missing, -2 before the first event
+  TH1D *fHistSo[4];             //!
+  std::vector<TH1D*> fHistEst;  //! per estimator
+  THnSparse *fHistPt;           //!
+
+  ClassDef(SoRtSpectra, 1);	// So/Rt distributions filled during generation
+};
+
+#endif
@@ -0,0 +1,293 @@
+#include "SpherocityKernel.h"
+
+#include "TMath.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SPHEROCITYKERNEL_X86
+#include <immintrin.h>
+#endif
+
+ClassImp(SpherocityKernel)
+
+namespace {
+
+  // out[k] = sum_j |ny*px_j - nx*py_j| * w[k][j], n is a multiple of 8
+  typedef void (*ProjectionFunc)(const Double_t *px, const Double_t *py, const Double_t *const *w,
+    Int_t n, Double_t nx, Double_t ny, Double_t *out);
+
+  void SumProjectionsScalar(const Double_t *px, const Double_t *py, const Double_t *const *w,
+    Int_t n, Double_t nx, Double_t ny, Double_t *out)
+  {
+    Double_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for(Int_t j = 0; j < n; j++) {
+      Double_t a = TMath::Abs(ny*px[j] - nx*py[j]);
+      s0 += a*w[0][j];
+      s1 += a*w[1][j];
+      s2 += a*w[2][j];
+      s3 += a*w[3][j];
+    }
+    out[0] = s0; out[1] = s1; out[2] = s2; out[3] = s3;
+  }
+
+#ifdef SPHEROCITYKERNEL_X86
+  __attribute__((target("avx2,fma")))
+  Double_t HorizontalSum(__m256d v)
+  {
+    __m128d lo = _mm256_castpd256_pd128(v);
+    __m128d hi = _mm256_extractf128_pd(v, 1);
+    lo = _mm_add_pd(lo, hi);
+    return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+  }
+
+  __attribute__((target("avx2,fma")))
+  void SumProjectionsAVX2(const Double_t *px, const Double_t *py, const Double_t *const *w,
+    Int_t n, Double_t nx, Double_t ny, Double_t *out)
+  {
+    const __m256d vnx = _mm256_set1_pd(nx);
+    const __m256d vny = _mm256_set1_pd(ny);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+    __m256d s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+    for(Int_t j = 0; j < n; j += 4) {
+      __m256d c = _mm256_fmsub_pd(vny, _mm256_loadu_pd(px+j), _mm256_mul_pd(vnx, _mm256_loadu_pd(py+j)));
+      __m256d a = _mm256_andnot_pd(sign, c);
+      s0 = _mm256_fmadd_pd(a, _mm256_loadu_pd(w[0]+j), s0);
+      s1 = _mm256_fmadd_pd(a, _mm256_loadu_pd(w[1]+j), s1);
+      s2 = _mm256_fmadd_pd(a, _mm256_loadu_pd(w[2]+j), s2);
+      s3 = _mm256_fmadd_pd(a, _mm256_loadu_pd(w[3]+j), s3);
+    }
+    out[0] = HorizontalSum(s0); out[1] = HorizontalSum(s1);
+    out[2] = HorizontalSum(s2); out[3] = HorizontalSum(s3);
+  }
+
+  __attribute__((target("avx512f")))
+  void SumProjectionsAVX512(const Double_t *px, const Double_t *py, const Double_t *const *w,
+    Int_t n, Double_t nx, Double_t ny, Double_t *out)
+  {
+    const __m512d vnx = _mm512_set1_pd(nx);
+    const __m512d vny = _mm512_set1_pd(ny);
+    __m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+    __m512d s2 = _mm512_setzero_pd(), s3 = _mm512_setzero_pd();
+    for(Int_t j = 0; j < n; j += 8) {
+      __m512d c = _mm512_fmsub_pd(vny, _mm512_loadu_pd(px+j), _mm512_mul_pd(vnx, _mm512_loadu_pd(py+j)));
+      __m512d a = _mm512_abs_pd(c);
+      s0 = _mm512_fmadd_pd(a, _mm512_loadu_pd(w[0]+j), s0);
+      s1 = _mm512_fmadd_pd(a, _mm512_loadu_pd(w[1]+j), s1);
+      s2 = _mm512_fmadd_pd(a, _mm512_loadu_pd(w[2]+j), s2);
+      s3 = _mm512_fmadd_pd(a, _mm512_loadu_pd(w[3]+j), s3);
+    }
+    out[0] = _mm512_reduce_add_pd(s0); out[1] = _mm512_reduce_add_pd(s1);
+    out[2] = _mm512_reduce_add_pd(s2); out[3] = _mm512_reduce_add_pd(s3);
+  }
+#endif
+
+}
+
+//____________________________________________________________________
+SpherocityKernel::SpherocityKernel():
+  fMinMulti(10),
+  fNtracks(0),
+  fIsa(GetBestIsa())
+{
+  for(Int_t k = 0; k < kNVariants; k++) {
+    fMulti[k] = 0;
+    fMinimizingIndex[k] = 0;
+  }
+};
+
+//____________________________________________________________________
+SpherocityKernel::EIsa SpherocityKernel::GetBestIsa() 
+{
+#ifdef SPHEROCITYKERNEL_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx512f"))
+    return kAVX512;
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return kAVX2;
+#endif
+  return kScalar;
+};
+
+//____________________________________________________________________
+const char *SpherocityKernel::GetIsaName(EIsa isa) 
+{
+  switch(isa) {
+    case kAVX512: return "avx512";
+    case kAVX2:   return "avx2";
+    default:      return "scalar";
+  }
+};
+
+//____________________________________________________________________
+void SpherocityKernel::SetIsa(EIsa isa) 
+{
+  // never go above what the cpu supports
+  fIsa = (isa > GetBestIsa()) ? GetBestIsa() : isa;
+};
+
+//____________________________________________________________________
+void SpherocityKernel::Reset() 
+{
+  fNtracks = 0;
+  fPx.clear(); fPy.clear(); fPt.clear(); fMask.clear();
+  for(Int_t k = 0; k < kNVariants; k++) {
+    fW[k].clear();
+    fMulti[k] = 0;
+  }
+};
+
+//____________________________________________________________________
+void SpherocityKernel::AddTrack(Double_t px, Double_t py, UInt_t mask) 
+{
+  Double_t pt = TMath::Sqrt(px*px + py*py);
+  Bool_t isGen = mask & kMaskGen;
+  Bool_t isRec = mask & kMaskRec;
+
+  fPx.push_back(px);
+  fPy.push_back(py);
+  fPt.push_back(pt);
+  fMask.push_back(mask);
+  fW[kGen].push_back(isGen ? 1. : 0.);
+  fW[kGenNoPt].push_back((isGen && pt > 0) ? 1./pt : 0.);
+  fW[kRec].push_back(isRec ? 1. : 0.);
+  fW[kRecNoPt].push_back((isRec && pt > 0) ? 1./pt : 0.);
+
+  if(isGen) fMulti[kGen]++;
+  if(isGen && pt > 0) fMulti[kGenNoPt]++;
+  if(isRec) fMulti[kRec]++;
+  if(isRec && pt > 0) fMulti[kRecNoPt]++;
+  fNtracks++;
+};
+
+//____________________________________________________________________
+void SpherocityKernel::Compute(Float_t *so) 
+{
+  // Same sweep as TransverseSpherocity::TracksSweep, for the four variants at
+  // once: for an axis n the tracks with ny*px - nx*py > 0 are those in the
+  // half-plane (phi_n - pi, phi_n), so sum_j w_j |n x p_j| follows from the
+  // weighted momentum summed over that half-plane. The tracks are sorted in
+  // azimuth once and each variant keeps its own prefix sums around the ring.
+  // Axes within rounding of a variant's minimum are then re-evaluated exactly.
+  ProjectionFunc sumProjections = SumProjectionsScalar;
+#ifdef SPHEROCITYKERNEL_X86
+  if(fIsa == kAVX512) sumProjections = SumProjectionsAVX512;
+  else if(fIsa == kAVX2) sumProjections = SumProjectionsAVX2;
+#endif
+
+  // pad with zero-weight tracks so the vector loops need no remainder
+  const Int_t nPadded = (fNtracks + 7) & ~7;
+  fPx.resize(nPadded, 0.); fPy.resize(nPadded, 0.);
+  for(Int_t k = 0; k < kNVariants; k++)
+    fW[k].resize(nPadded, 0.);
+  const Double_t *w[kNVariants] = { fW[0].data(), fW[1].data(), fW[2].data(), fW[3].data() };
+
+  // sum of pT for gen/rec, number of unit vectors for the NoPt variants,
+  // and the weighted momentum over all tracks
+  Double_t norm[kNVariants] = { 0, 0, 0, 0 };
+  Double_t sumPx[kNVariants] = { 0, 0, 0, 0 };
+  Double_t sumPy[kNVariants] = { 0, 0, 0, 0 };
+  for(Int_t j = 0; j < fNtracks; j++)
+    for(Int_t k = 0; k < kNVariants; k++) {
+      norm[k] += fPt[j]*w[k][j];
+      sumPx[k] += fPx[j]*w[k][j];
+      sumPy[k] += fPy[j]*w[k][j];
+    }
+
+  // every gen track with pT > 0 is a candidate axis; rec variants only take rec tracks.
+  // Below kSweepMinTracks the sort costs more than trying every axis exactly.
+  const Double_t noAxis = 1e300;
+  const Bool_t sweep = fNtracks >= kSweepMinTracks;
+  Double_t projMin[kNVariants] = { noAxis, noAxis, noAxis, noAxis };
+  for(Int_t k = 0; k < kNVariants; k++)
+    fProj[k].assign(fNtracks, noAxis);
+  fOrder.clear();
+  fPhi.resize(fNtracks);
+  for(Int_t j = 0; j < fNtracks; j++) {
+    if(fPt[j] <= 0) // neither projects nor defines an axis
+      continue;
+    fOrder.push_back(j);
+    fPhi[j] = sweep ? TMath::ATan2(fPy[j], fPx[j]) : 0.;
+  }
+  if(sweep)
+    std::sort(fOrder.begin(), fOrder.end(), [this](Int_t a, Int_t b) { 
+      return fPhi[a] < fPhi[b] || (fPhi[a] == fPhi[b] && a < b); });
+
+  // prefix sums over the ring traversed twice, position m has angle phi + 2pi*(m/n)
+  const Int_t n = sweep ? fOrder.size() : 0;
+  for(Int_t k = 0; k < kNVariants; k++) {
+    fSumPx[k].resize(2*n+1);
+    fSumPy[k].resize(2*n+1);
+    fSumPx[k][0] = 0; fSumPy[k][0] = 0;
+  }
+  for(Int_t m = 0; m < 2*n; m++) {
+    Int_t j = fOrder[m%n];
+    for(Int_t k = 0; k < kNVariants; k++) {
+      fSumPx[k][m+1] = fSumPx[k][m] + fPx[j]*w[k][j];
+      fSumPy[k][m+1] = fSumPy[k][m] + fPy[j]*w[k][j];
+    }
+  }
+
+  Int_t lo = 0;
+  for(Int_t q = 0; q < (Int_t)fOrder.size(); q++) {
+    Int_t i = fOrder[q];
+    if(sweep) {
+      Double_t phiAxis = fPhi[i] + TMath::TwoPi();
+      while(fPhi[fOrder[lo%n]] + (lo < n ? 0. : TMath::TwoPi()) <= phiAxis - TMath::Pi())
+        lo++;
+    }
+    if(!(fMask[i] & kMaskGen))
+      continue;
+    Bool_t recAxis = fMask[i] & kMaskRec;
+
+    Double_t nx = fPx[i]/fPt[i];
+    Double_t ny = fPy[i]/fPt[i];
+    for(Int_t k = 0; k < kNVariants; k++) {
+      if((k == kRec || k == kRecNoPt) && !recAxis)
+        continue;
+      if(!sweep) { // exact evaluation below
+        fProj[k][i] = projMin[k] = 0;
+        continue;
+      }
+      Double_t halfPx = fSumPx[k][q+n] - fSumPx[k][lo]; // tracks in (phi_n - pi, phi_n)
+      Double_t halfPy = fSumPy[k][q+n] - fSumPy[k][lo];
+      fProj[k][i] = ny*(2*halfPx - sumPx[k]) - nx*(2*halfPy - sumPy[k]);
+      if(fProj[k][i] < projMin[k])
+        projMin[k] = fProj[k][i];
+    }
+  }
+
+  // exact projections for the near-tie axes, in track order as the reference
+  Double_t best[kNVariants] = { -1, -1, -1, -1 };
+  Double_t proj[kNVariants];
+  for(Int_t i = 0; i < fNtracks; i++) {
+    Bool_t candidate[kNVariants];
+    Bool_t anyCandidate = kFALSE;
+    for(Int_t k = 0; k < kNVariants; k++) {
+      candidate[k] = fProj[k][i] != noAxis && fProj[k][i] <= projMin[k] + 1e-9*norm[k];
+      anyCandidate |= candidate[k];
+    }
+    if(!anyCandidate)
+      continue;
+
+    sumProjections(fPx.data(), fPy.data(), w, nPadded, fPx[i]/fPt[i], fPy[i]/fPt[i], proj);
+
+    for(Int_t k = 0; k < kNVariants; k++) {
+      if(!candidate[k])
+        continue;
+      if(best[k] < 0 || proj[k] < best[k]) {
+        best[k] = proj[k];
+        fMinimizingIndex[k] = i;
+      }
+    }
+  }
+
+  for(Int_t k = 0; k < kNVariants; k++) {
+    if(fMulti[k] < fMinMulti || best[k] < 0 || norm[k] <= 0) {
+      so[k] = -1;
+      continue;
+    }
+    so[k] = TMath::Power(best[k]/norm[k], 2) * TMath::Pi()*TMath::Pi()/4.0;
+  }
+};
@@ -0,0 +1,63 @@
+#ifndef SPHEROCITYKERNEL__H
+#define SPHEROCITYKERNEL__H
+
+#include "TNamed.h"
+
+#include <vector>
+
+// Batched track-axis spherocity: gen, genNoPt, rec and recNoPt are evaluated
+// together from one structure-of-arrays track buffer. Every track carries a
+// selection mask (kMaskGen, kMaskRec); the NoPt variants use the same axes with
+// the projections divided by pT. The axes are scanned with the azimuthal sweep
+// of TransverseSpherocity, with prefix sums kept for every variant, and only the
+// axes within rounding of a minimum are re-evaluated exactly by a vectorised
+// loop over the tracks (AVX-512, AVX2 or scalar, chosen at runtime). S0 and the
+// minimizing track agree with TransverseSpherocity::GetTransverseSpherocityTracks().
+class SpherocityKernel : public TNamed {
+ public:
+  enum { kGen, kGenNoPt, kRec, kRecNoPt, kNVariants }; // same order as evSo[] in makeTreeSoRt
+  enum { kMaskGen = 1, kMaskRec = 2 };
+  enum EIsa { kScalar, kAVX2, kAVX512 };
+  enum { kSweepMinTracks = 256 }; // fewer tracks: every axis is evaluated exactly
+
+  SpherocityKernel();
+  ~SpherocityKernel() {}
+
+  void Reset();
+  void AddTrack(Double_t px, Double_t py, UInt_t mask);
+  void Compute(Float_t *so); // fills so[kNVariants], -1 for variants below min multiplicity
+
+  void SetMinMulti(Int_t minMulti) { fMinMulti = minMulti; }
+  void SetIsa(EIsa isa);     // force an instruction set, e.g. kScalar for validation
+  EIsa GetIsa() { return fIsa; }
+  const char *GetIsaName() { return GetIsaName(fIsa); }
+  static const char *GetIsaName(EIsa isa); // "scalar", "avx2" or "avx512"
+  static EIsa GetBestIsa();
+  Int_t GetNTracks() { return fNtracks; }
+  Int_t GetMinimizingTrackIndex(Int_t variant) { return fMinimizingIndex[variant]; }
+
+ private:
+
+  Int_t fMinMulti;
+  Int_t fNtracks;
+  EIsa  fIsa;
+  Int_t fMulti[kNVariants];
+  Int_t fMinimizingIndex[kNVariants];
+
+  // padded to a multiple of 8 with zero weights
+  std::vector<Double_t> fPx;  //!
+  std::vector<Double_t> fPy;  //!
+  std::vector<Double_t> fPt;  //!
+  std::vector<Double_t> fW[kNVariants]; //! per-variant weight of |n x p|
+  std::vector<UInt_t>   fMask; //!
+
+  std::vector<Int_t>    fOrder; //! tracks with pT > 0 sorted in azimuth
+  std::vector<Double_t> fPhi;   //!
+  std::vector<Double_t> fSumPx[kNVariants]; //! weighted prefix sums over the doubled azimuth ring
+  std::vector<Double_t> fSumPy[kNVariants]; //!
+  std::vector<Double_t> fProj[kNVariants];  //! swept projection sum for each track axis
+
+  ClassDef(SpherocityKernel, 2);
+};
+
+#endif
@@ -0,0 +1,93 @@
+#include "TrackColumns.h"
+
+#include "TTree.h"
+#include "TBranch.h"
+
+ClassImp(TrackColumns)
+
+TrackColumns::TrackColumns(Int_t maxTracks):
+  fMaxTracks(maxTracks),
+  fNtracks(0),
+  fNoverflows(0)
+{
+  fPx = new Float16_t[fMaxTracks];
+  fPy = new Float16_t[fMaxTracks];
+  fPz = new Float16_t[fMaxTracks];
+  fPdg = new Short_t[fMaxTracks];
+  fMother = new Short_t[fMaxTracks];
+  fCharge = new Char_t[fMaxTracks];
+  fFlags = new UChar_t[fMaxTracks];
+};
+
+//____________________________________________________________________
+TrackColumns::~TrackColumns() 
+{
+  delete [] fPx;
+  delete [] fPy;
+  delete [] fPz;
+  delete [] fPdg;
+  delete [] fMother;
+  delete [] fCharge;
+  delete [] fFlags;
+};
+
+//____________________________________________________________________
+Int_t TrackColumns::AddTrack(Float_t px, Float_t py, Float_t pz, Int_t pdg, Int_t charge3, Int_t mother, UChar_t flags) 
+{
+  if(fNtracks >= fMaxTracks) {
+    fNoverflows++;
+    return -1;
+  }
+
+  fPx[fNtracks] = px;
+  fPy[fNtracks] = py;
+  fPz[fNtracks] = pz;
+  fPdg[fNtracks] = (TMath::Abs(pdg) > 32767) ? 0 : pdg; // codes beyond int16 (nuclei) are not kept
+  fMother[fNtracks] = mother;
+  fCharge[fNtracks] = charge3;
+  fFlags[fNtracks] = flags;
+
+  return fNtracks++;
+};
+
+//____________________________________________________________________
+Float_t TrackColumns::Eta(Int_t i) 
+{
+  Double_t pt = Pt(i);
+  if(pt <= 0)
+    return (fPz[i] >= 0) ? 1e10 : -1e10;
+
+  return TMath::ASinH(fPz[i]/pt);
+};
+
+//____________________________________________________________________
+void TrackColumns::MakeBranches(TTree *tree, Int_t nBits) 
+{
+  // nBits mantissa bits are kept for the momenta, the exponent is kept in full
+  tree->Branch("nTracks", &fNtracks, "nTracks/I");
+  tree->Branch("trPx", fPx, Form("trPx[nTracks]/f[0,0,%i]", nBits));
+  tree->Branch("trPy", fPy, Form("trPy[nTracks]/f[0,0,%i]", nBits));
+  tree->Branch("trPz", fPz, Form("trPz[nTracks]/f[0,0,%i]", nBits));
+  tree->Branch("trPdg", fPdg, "trPdg[nTracks]/S");
+  tree->Branch("trMother", fMother, "trMother[nTracks]/S");
+  tree->Branch("trCharge", fCharge, "trCharge[nTracks]/B");
+  tree->Branch("trFlags", fFlags, "trFlags[nTracks]/b");
+};
+
+//____________________________________________________________________
+Bool_t TrackColumns::SetBranchAddresses(TTree *tree) 
+{
+  if(!tree->GetBranch("nTracks"))
+    return kFALSE;
+
+  tree->SetBranchAddress("nTracks", &fNtracks);
+  tree->SetBranchAddress("trPx", fPx);
+  tree->SetBranchAddress("trPy", fPy);
+  tree->SetBranchAddress("trPz", fPz);
+  tree->SetBranchAddress("trPdg", fPdg);
+  tree->SetBranchAddress("trMother", fMother);
+  tree->SetBranchAddress("trCharge", fCharge);
+  tree->SetBranchAddress("trFlags", fFlags);
+
+  return kTRUE;
+};
@@ -0,0 +1,59 @@
+#ifndef TRACKCOLUMNS__H
+#define TRACKCOLUMNS__H
+
+#include "TNamed.h"
+#include "TMath.h"
+
+class TTree;
+
+// Flat per-event track arrays, a compact alternative to the TClonesArray of
+// TParticle. Momenta are stored as Float16_t with a configurable number of
+// mantissa bits, the charge in units of e/3 and the mother as the index of
+// the mother within the same event (-1 if it was not saved).
+// The same class writes (MakeBranches) and reads (SetBranchAddresses).
+class TrackColumns : public TNamed {
+ public:
+  enum { kReco = BIT(0), kFinal = BIT(1) };
+
+  TrackColumns(Int_t maxTracks = 10000);
+  ~TrackColumns();
+
+  void Reset() { fNtracks = 0; }
+  Int_t AddTrack(Float_t px, Float_t py, Float_t pz, Int_t pdg, Int_t charge3, Int_t mother, UChar_t flags);
+  void SetReco(Int_t i, Bool_t isReco) { if(isReco) fFlags[i] |= kReco; else fFlags[i] &= ~kReco; }
+
+  void MakeBranches(TTree *tree, Int_t nBits = 12);
+  Bool_t SetBranchAddresses(TTree *tree);
+
+  Int_t GetNTracks() { return fNtracks; }
+  Float_t Px(Int_t i) { return fPx[i]; }
+  Float_t Py(Int_t i) { return fPy[i]; }
+  Float_t Pz(Int_t i) { return fPz[i]; }
+  Float_t Pt(Int_t i) { return TMath::Sqrt(fPx[i]*fPx[i] + fPy[i]*fPy[i]); }
+  Float_t Phi(Int_t i) { return TMath::ATan2(fPy[i], fPx[i]); }
+  Float_t Eta(Int_t i);
+  Int_t   Pdg(Int_t i) { return fPdg[i]; }
+  Float_t Charge(Int_t i) { return fCharge[i]/3.; }
+  Bool_t  IsCharged(Int_t i) { return fCharge[i] != 0; }
+  Bool_t  IsReco(Int_t i) { return fFlags[i] & kReco; }
+  Bool_t  IsFinal(Int_t i) { return fFlags[i] & kFinal; }
+  Int_t   Mother(Int_t i) { return fMother[i]; }
+  Int_t   GetNOverflows() { return fNoverflows; }
+
+ private:
+
+  Int_t     fMaxTracks;
+  Int_t     fNtracks;
+  Int_t     fNoverflows;  // tracks dropped because the event was full
+  Float16_t *fPx;     //!
+  Float16_t *fPy;     //!
+  Float16_t *fPz;     //!
+  Short_t   *fPdg;    //!
+  Short_t   *fMother; //!
+  Char_t    *fCharge; //!
+  UChar_t   *fFlags;  //!
+
+  ClassDef(TrackColumns, 1);
+};
+
+#endif
@@ -1,88 +1,264 @@
 #include "TransverseSpherocity.h"
 
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
 ClassImp(TransverseSpherocity)
 
 TransverseSpherocity::TransverseSpherocity():
   fMinMulti(10),
   fNtracks(0),
-  fMinimizingIndex(0)
+  fFillQA(kFALSE),
+  fHistSpher(0),
+  fMinimizingIndex(0),
+  fAlgorithm(kSweep),
+  fGridStep(1.),
+  fGridTolerance(0.01),
+  fGridMaxError(0.),
+  fGridAxis(0.),
+  fGridError(-1.)
 {
-
-  fPx = new Double_t[10000];
-  fPy = new Double_t[10000];
-
-  fHistSpher = new TH1D("histSpher","Spher; S_{0}; Counts", 50, 0, 1);
-  fHistSpher->Sumw2();
-  fHistSpher->SetDirectory(0);
 };
 
 
 //____________________________________________________________________
 TransverseSpherocity::~TransverseSpherocity() 
 {
-  delete [] fPx;
-  delete [] fPy;
   delete fHistSpher;
 };
 
+//____________________________________________________________________
+void TransverseSpherocity::Grow(Int_t n) 
+{
+  // doubling, in whole 64-byte lines
+  Int_t size = TMath::Max(n, 2*(Int_t)fPx.size());
+  size = (size + 7) & ~7;
+  fPx.resize(size);
+  fPy.resize(size);
+};
+
+//____________________________________________________________________
+void TransverseSpherocity::AddTracks(Int_t n, const Double_t *px, const Double_t *py) 
+{
+  if(fNtracks + n > (Int_t)fPx.size())
+    Grow(fNtracks + n);
+  std::copy(px, px + n, fPx.begin() + fNtracks);
+  std::copy(py, py + n, fPy.begin() + fNtracks);
+  fNtracks += n;
+};
+
+//____________________________________________________________________
+void TransverseSpherocity::AddTracks(Int_t n, const Float_t *px, const Float_t *py) 
+{
+  if(fNtracks + n > (Int_t)fPx.size())
+    Grow(fNtracks + n);
+  std::copy(px, px + n, fPx.begin() + fNtracks);
+  std::copy(py, py + n, fPy.begin() + fNtracks);
+  fNtracks += n;
+};
+
+//____________________________________________________________________
+void TransverseSpherocity::SetFillQA(Bool_t fill) 
+{
+  fFillQA = fill;
+  if(fill && !fHistSpher) {
+    fHistSpher = new TH1D("histSpher","Spher; S_{0}; Counts", 50, 0, 1);
+    fHistSpher->Sumw2();
+    fHistSpher->SetDirectory(0);
+  }
+};
+
+//____________________________________________________________________
+void TransverseSpherocity::SetGridStep(Double_t degrees) 
+{
+  // directions over half the azimuth, the projection sum is periodic in pi
+  Int_t n = TMath::Max(4, TMath::Nint(180./degrees));
+  fGridStep = 180./n;
+  fGridCos.resize(n);
+  fGridSin.resize(n);
+  for(Int_t k = 0; k < n; k++) {
+    fGridCos[k] = TMath::Cos(k*TMath::Pi()/n);
+    fGridSin[k] = TMath::Sin(k*TMath::Pi()/n);
+  }
+};
+
 //____________________________________________________________________
 Double_t TransverseSpherocity::GetTransverseSpherocity() 
 {  
+  // sum_j |n x p_j| is concave in the axis angle between track directions, so
+  // its minimum is at a kink close to a local minimum of the coarse grid.
+  // The grid is scanned with the tabulated directions, then the brackets
+  // around its local minima that can still hold a lower value (the slope is
+  // bounded by sum pT) are refined by golden section down to fGridTolerance.
+  // With SetGridMaxError a branch and bound on that slope limit follows,
+  // which guarantees S0 within the error of the minimum over all axes.
+  fGridError = -1;
   if(fNtracks < fMinMulti) 
     return -1;
-  
-  Int_t stepSize=0.01;
-  Double_t RetTransverseSpherocity = 1000;
+
   Double_t sumpt = 0;
-  for(Int_t i = 0; i < 360/stepSize; ++i) {
-    
-    //Divide the whole azimuth into segments and do the projection on these segments (below)
-    Double_t phiparam = ((TMath::Pi()) * i * stepSize) / 180; 
-    Double_t nx = TMath::Cos(phiparam); // x component of a unitary vector n
-    Double_t ny = TMath::Sin(phiparam); // y component of a unitary vector n
-    
-    Double_t num = 0;
-    for(Int_t j = 0; j < fNtracks; j++) {
-      num += TMath::Abs(ny*fPx[j] - nx*fPy[j]);
+  for(Int_t j = 0; j < fNtracks; j++)
+    sumpt += TMath::Sqrt(fPx[j]*fPx[j] + fPy[j]*fPy[j]);
 
-      if(i==0)
-	sumpt += TMath::Sqrt(fPx[j]*fPx[j] + fPy[j]*fPy[j]);
+  if(fGridCos.empty())
+    SetGridStep(fGridStep);
+  const Int_t n = fGridCos.size();
+  const Double_t h = TMath::Pi()/n;
+
+  // four directions per pass over the tracks
+  fGridSum.resize(n);
+  Int_t k = 0;
+  for(; k + 4 <= n; k += 4) {
+    const Double_t *c = &fGridCos[k], *s = &fGridSin[k];
+    const Double_t *px = fPx.data(), *py = fPy.data();
+    Double_t sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+    for(Int_t j = 0; j < fNtracks; j++) {
+      sum0 += TMath::Abs(s[0]*px[j] - c[0]*py[j]);
+      sum1 += TMath::Abs(s[1]*px[j] - c[1]*py[j]);
+      sum2 += TMath::Abs(s[2]*px[j] - c[2]*py[j]);
+      sum3 += TMath::Abs(s[3]*px[j] - c[3]*py[j]);
     }
+    fGridSum[k] = sum0; fGridSum[k+1] = sum1; fGridSum[k+2] = sum2; fGridSum[k+3] = sum3;
+  }
+  for(; k < n; k++)
+    fGridSum[k] = SumProjections(fGridCos[k], fGridSin[k]);
 
-    Double_t pFull = TMath::Power((num/sumpt), 2); //Projection of sp. on the segment
-    if(pFull < RetTransverseSpherocity)  //Select the lowest projection
-      RetTransverseSpherocity = pFull;
-  };
+  Int_t kMin = std::min_element(fGridSum.begin(), fGridSum.end()) - fGridSum.begin();
+  Double_t num = fGridSum[kMin];
+  fGridAxis = kMin*h;
 
-  RetTransverseSpherocity *= TMath::Pi()*TMath::Pi()/4.0;
-  fHistSpher->Fill(RetTransverseSpherocity);
+  const Double_t tolerance = fGridTolerance*TMath::Pi()/180.;
+  const Double_t fMin = num;
+  for(k = 0; k < n; k++) {
+    Double_t f = fGridSum[k];
+    if(f > fGridSum[(k+n-1)%n] || f > fGridSum[(k+1)%n] || f - sumpt*h >= fMin)
+      continue;
+    Double_t phi;
+    f = GridRefine((k-1)*h, (k+1)*h, tolerance, phi);
+    if(f < num) {
+      num = f;
+      fGridAxis = phi;
+    }
+  }
+  if(fGridMaxError > 0)
+    num = GridBound(sumpt, num, fGridAxis);
+  fGridAxis = fmod(fGridAxis + TMath::TwoPi(), TMath::Pi());
+
+  Double_t RetTransverseSpherocity = (num/sumpt)*(num/sumpt)*TMath::Pi()*TMath::Pi()/4.0;
+  if(fFillQA)
+    fHistSpher->Fill(RetTransverseSpherocity);
   
   return RetTransverseSpherocity;
 };
 
+//____________________________________________________________________
+Double_t TransverseSpherocity::GridRefine(Double_t a, Double_t b, Double_t tolerance, Double_t &phiMin) 
+{
+  // golden section search on [a, b]
+  const Double_t r = 0.5*(TMath::Sqrt(5.) - 1.);
+  Double_t x1 = b - r*(b - a), x2 = a + r*(b - a);
+  Double_t f1 = SumProjections(x1), f2 = SumProjections(x2);
+  while(b - a > tolerance) {
+    if(f1 < f2) {
+      b = x2; x2 = x1; f2 = f1;
+      x1 = b - r*(b - a);
+      f1 = SumProjections(x1);
+    }
+    else {
+      a = x1; x1 = x2; f1 = f2;
+      x2 = a + r*(b - a);
+      f2 = SumProjections(x2);
+    }
+  }
+  phiMin = (f1 < f2) ? x1 : x2;
+  return TMath::Min(f1, f2);
+};
+
+//____________________________________________________________________
+Double_t TransverseSpherocity::GridBound(Double_t sumpt, Double_t fMin, Double_t &phiMin) 
+{
+  // Between two evaluated axes a and b no axis can be below
+  // (f(a) + f(b) - sumpt*(b - a))/2. The interval with the lowest such bound
+  // is split until the bound is within fGridMaxError of the best S0.
+  struct Interval {
+    Double_t fLow, fA, fFa, fB, fFb;
+    bool operator<(const Interval &o) const { return fLow > o.fLow; } // lowest bound on top
+  };
+  auto interval = [sumpt](Double_t a, Double_t fa, Double_t b, Double_t fb) {
+    Interval i = { 0.5*(fa + fb - sumpt*(b - a)), a, fa, b, fb };
+    return i;
+  };
+
+  const Int_t n = fGridSum.size();
+  const Double_t h = TMath::Pi()/n;
+  std::priority_queue<Interval> queue;
+  for(Int_t k = 0; k < n; k++)
+    queue.push(interval(k*h, fGridSum[k], (k+1)*h, fGridSum[(k+1)%n]));
+
+  const Double_t norm = TMath::Pi()*TMath::Pi()/(4*sumpt*sumpt);
+  Double_t low = 0;
+  while(!queue.empty()) {
+    Interval i = queue.top();
+    low = TMath::Max(i.fLow, 0.);
+    if(norm*(fMin*fMin - low*low) <= fGridMaxError || i.fB - i.fA < 1e-12)
+      break;
+    queue.pop();
+
+    Double_t m = 0.5*(i.fA + i.fB);
+    Double_t fm = SumProjections(m);
+    if(fm < fMin) {
+      fMin = fm;
+      phiMin = m;
+    }
+    queue.push(interval(i.fA, i.fFa, m, fm));
+    queue.push(interval(m, fm, i.fB, i.fFb));
+  }
+
+  fGridError = norm*(fMin*fMin - low*low);
+  return fMin;
+};
+
 //____________________________________________________________________
 Double_t TransverseSpherocity::GetTransverseSpherocityTracks() 
 {  
   if(fNtracks < fMinMulti) 
     return -1;
-  
-  //Int_t stepSize=2; //do not need this one here right?
+
+  Double_t RetTransverseSpherocity = (fAlgorithm == kBruteForce) ? TracksBruteForce() : TracksSweep();
+  if(fFillQA)
+    fHistSpher->Fill(RetTransverseSpherocity);
+
+  return RetTransverseSpherocity;
+};
+
+//____________________________________________________________________
+Double_t TransverseSpherocity::SumProjections(Double_t nx, Double_t ny) 
+{
+  const Double_t *px = fPx.data(), *py = fPy.data();
+  Double_t num = 0;
+  for(Int_t j = 0; j < fNtracks; j++)
+    num += TMath::Abs(ny*px[j] - nx*py[j]);
+
+  return num;
+};
+
+//____________________________________________________________________
+Double_t TransverseSpherocity::TracksBruteForce() 
+{  
+  // Reference: every track is tried as the axis, O(N^2)
   Double_t RetTransverseSpherocity = 1000;
   Double_t sumpt = 0;
-  //const Double_t pt = 1;
+  for(Int_t j = 0; j < fNtracks; j++)
+    sumpt += TMath::Sqrt(fPx[j]*fPx[j] + fPy[j]*fPy[j]);
+
   for(Int_t i = 0; i < fNtracks; i++) {
     
     Double_t pt = TMath::Sqrt(fPx[i]*fPx[i] + fPy[i]*fPy[i]);
     Double_t nx =fPx[i] / pt; // x component of a unitary vector n
     Double_t ny =fPy[i] / pt; // y component of a unitary vector n
     
-    Double_t num = 0;
-    for(Int_t j = 0; j < fNtracks; j++) {
-      num += TMath::Abs(ny*fPx[j] - nx*fPy[j]);
-
-      if(i==0)
-	sumpt += TMath::Sqrt(fPx[j]*fPx[j] + fPy[j]*fPy[j]);
-    }
+    Double_t num = SumProjections(nx, ny);
 
     Double_t pFull = TMath::Power((num/sumpt), 2); //Projection of sp. on the segment
     if(pFull < RetTransverseSpherocity)  { //Select the lowest projection
@@ -92,8 +268,83 @@ Double_t TransverseSpherocity::GetTransverseSpherocityTracks()
   };
 
   RetTransverseSpherocity *= TMath::Pi()*TMath::Pi()/4.0;
-  fHistSpher->Fill(RetTransverseSpherocity);
   
   return RetTransverseSpherocity;
 };
 
+//____________________________________________________________________
+Double_t TransverseSpherocity::TracksSweep() 
+{  
+  // Same result as TracksBruteForce in O(N log N).
+  // For an axis n the tracks with ny*px - nx*py > 0 are exactly those in the
+  // half-plane (phi_n - pi, phi_n), so sum_j |ny*px_j - nx*py_j| follows from
+  // the momentum summed over that half-plane. Tracks are sorted in azimuth once
+  // and the half-plane is swept around the ring with prefix sums.
+  // Axes within rounding of the minimum are then re-evaluated exactly as in the
+  // reference, so the returned S0 and minimizing index are identical to it.
+  const Int_t n = fNtracks;
+  Double_t sumpt = 0, sumPx = 0, sumPy = 0;
+  fOrder.resize(n);
+  fPhi.resize(n);
+  for(Int_t j = 0; j < n; j++) {
+    sumpt += TMath::Sqrt(fPx[j]*fPx[j] + fPy[j]*fPy[j]);
+    sumPx += fPx[j];
+    sumPy += fPy[j];
+    fOrder[j] = j;
+    fPhi[j] = TMath::ATan2(fPy[j], fPx[j]);
+  }
+  std::sort(fOrder.begin(), fOrder.end(), [this](Int_t a, Int_t b) { 
+    return fPhi[a] < fPhi[b] || (fPhi[a] == fPhi[b] && a < b); });
+
+  // prefix sums over the ring traversed twice, position m has angle phi + 2pi*(m/n)
+  fSumPx.resize(2*n+1);
+  fSumPy.resize(2*n+1);
+  fSumPx[0] = 0; fSumPy[0] = 0;
+  for(Int_t m = 0; m < 2*n; m++) {
+    Int_t j = fOrder[m%n];
+    fSumPx[m+1] = fSumPx[m] + fPx[j];
+    fSumPy[m+1] = fSumPy[m] + fPy[j];
+  }
+
+  const Double_t noAxis = 1e300;
+  Double_t projMin = noAxis;
+  fProj.resize(n);
+  Int_t lo = 0;
+  for(Int_t q = n; q < 2*n; q++) {
+    Int_t i = fOrder[q-n];
+    Double_t phiAxis = fPhi[i] + TMath::TwoPi();
+    while(fPhi[fOrder[lo%n]] + (lo < n ? 0. : TMath::TwoPi()) <= phiAxis - TMath::Pi())
+      lo++;
+
+    Double_t pt = TMath::Sqrt(fPx[i]*fPx[i] + fPy[i]*fPy[i]);
+    if(pt <= 0) { fProj[i] = noAxis; continue; } // undefined axis, never chosen by the reference either
+    Double_t nx = fPx[i] / pt;
+    Double_t ny = fPy[i] / pt;
+
+    Double_t halfPx = fSumPx[q] - fSumPx[lo]; // tracks in (phi_n - pi, phi_n)
+    Double_t halfPy = fSumPy[q] - fSumPy[lo];
+    fProj[i] = ny*(2*halfPx - sumPx) - nx*(2*halfPy - sumPy);
+    if(fProj[i] < projMin)
+      projMin = fProj[i];
+  }
+
+  Double_t RetTransverseSpherocity = 1000;
+  const Double_t tolerance = 1e-9*sumpt;
+  for(Int_t i = 0; i < n; i++) {
+    if(fProj[i] == noAxis || fProj[i] > projMin + tolerance)
+      continue;
+
+    Double_t pt = TMath::Sqrt(fPx[i]*fPx[i] + fPy[i]*fPy[i]);
+    Double_t num = SumProjections(fPx[i] / pt, fPy[i] / pt);
+
+    Double_t pFull = TMath::Power((num/sumpt), 2);
+    if(pFull < RetTransverseSpherocity)  {
+      RetTransverseSpherocity = pFull;
+      fMinimizingIndex = i;
+    };
+  }
+
+  RetTransverseSpherocity *= TMath::Pi()*TMath::Pi()/4.0;
+  
+  return RetTransverseSpherocity;
+};
@@ -5,29 +5,93 @@
 #include "TMath.h"
 #include "TH1.h"
 
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// 64-byte aligned storage for the track buffers
+template <typename T> struct AlignedAllocator {
+  typedef T value_type;
+  AlignedAllocator() {}
+  template <typename U> AlignedAllocator(const AlignedAllocator<U>&) {}
+  T* allocate(std::size_t n) {
+    void *p = 0;
+    if(posix_memalign(&p, 64, n*sizeof(T)))
+      throw std::bad_alloc();
+    return (T*)p;
+  }
+  void deallocate(T *p, std::size_t) { free(p); }
+  template <typename U> bool operator==(const AlignedAllocator<U>&) const { return true; }
+  template <typename U> bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
+
+// The track buffers grow with the largest event seen and are kept across
+// Reset(), so filling does not allocate once they are large enough.
+// The QA histogram of S0 is only booked and filled after SetFillQA().
 class TransverseSpherocity : public TNamed {
  public:
+  enum EAlgorithm { kSweep, kBruteForce }; // kBruteForce is the O(N^2) reference
+
   TransverseSpherocity(); //default
   ~TransverseSpherocity();
   
   void Reset() { fNtracks = 0; }
-  void AddTrack(Double_t px, Double_t py) { fPx[fNtracks] = px; fPy[fNtracks] = py; fNtracks++; }
-  Double_t GetTransverseSpherocity();
-  Double_t GetTransverseSpherocityTracks(); //erase if not coreect
-  TH1D* GetHistSpher() { return fHistSpher; } 
+  void AddTrack(Double_t px, Double_t py) {
+    if(fNtracks == (Int_t)fPx.size())
+      Grow(fNtracks+1);
+    fPx[fNtracks] = px; fPy[fNtracks] = py; fNtracks++;
+  }
+  void AddTracks(Int_t n, const Double_t *px, const Double_t *py);
+  void AddTracks(Int_t n, const Float_t *px, const Float_t *py);
+  Double_t GetTransverseSpherocity(); //continuous axis, coarse grid scan and refinement
+  Double_t GetTransverseSpherocityTracks(); //track axes only, algorithm set by SetAlgorithm
+  void SetFillQA(Bool_t fill);
+  TH1D* GetHistSpher() { return fHistSpher; } // 0 unless SetFillQA(kTRUE)
   Int_t GetMinimizingTrackIndex() { return fMinimizingIndex; };
   void SetMinMulti(Int_t minMulti) { fMinMulti = minMulti; }
+  void SetAlgorithm(EAlgorithm algo) { fAlgorithm = algo; }
+  EAlgorithm GetAlgorithm() { return fAlgorithm; }
   Int_t GetNTracks() { return fNtracks; };
+
+  void SetGridStep(Double_t degrees); // coarse scan, default 1
+  void SetGridTolerance(Double_t degrees) { fGridTolerance = degrees; } // axis refinement, default 0.01
+  void SetGridMaxError(Double_t maxError) { fGridMaxError = maxError; } // guaranteed bound on S0, 0 is off
+  Double_t GetGridAxis() { return fGridAxis; } // azimuth of the last axis found, in [0, pi)
+  Double_t GetGridError() { return fGridError; } // bound of the last call, -1 without SetGridMaxError
  private:
 
+  void Grow(Int_t n);
+  Double_t TracksSweep();
+  Double_t TracksBruteForce();
+  Double_t SumProjections(Double_t nx, Double_t ny);
+  Double_t SumProjections(Double_t phi) { return SumProjections(TMath::Cos(phi), TMath::Sin(phi)); }
+  Double_t GridRefine(Double_t a, Double_t b, Double_t tolerance, Double_t &phiMin);
+  Double_t GridBound(Double_t sumpt, Double_t fMin, Double_t &phiMin);
+
   Int_t    fMinMulti;
   Int_t    fNtracks;
-  Double_t *fPx; //!
-  Double_t *fPy; //!
+  std::vector<Double_t, AlignedAllocator<Double_t> > fPx; //!
+  std::vector<Double_t, AlignedAllocator<Double_t> > fPy; //!
+  Bool_t   fFillQA;
   TH1D     *fHistSpher;
   Int_t fMinimizingIndex;
+  EAlgorithm fAlgorithm;
+  Double_t fGridStep;      // degrees
+  Double_t fGridTolerance; // degrees
+  Double_t fGridMaxError;
+  Double_t fGridAxis;      //!
+  Double_t fGridError;     //!
+
+  std::vector<Int_t>    fOrder;  //! track indices sorted in azimuth
+  std::vector<Double_t> fPhi;    //!
+  std::vector<Double_t> fSumPx;  //! prefix sums over the doubled azimuth ring
+  std::vector<Double_t> fSumPy;  //!
+  std::vector<Double_t> fProj;   //! projection sum for each track axis
+  std::vector<Double_t> fGridCos; //! coarse directions over [0, pi)
+  std::vector<Double_t> fGridSin; //!
+  std::vector<Double_t> fGridSum; //! projection sum for each coarse direction
 
-  ClassDef(TransverseSpherocity, 1);
+  ClassDef(TransverseSpherocity, 4);
 };
 
 #endif
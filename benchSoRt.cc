@@ -0,0 +1,341 @@
+// Benchmarks of the analysis hot paths on synthetic events, no Pythia needed.
+// Events are drawn with a fixed seed from a simple model: an isotropic soft
+// component plus two back-to-back jets taking a fraction "jettiness" of the
+// particles, a configurable species mix and phi -> K+K- decays for the
+// resonance matching. Every benchmark runs over a pool of events per
+// multiplicity until a minimum time has passed. The results are printed as a
+// table and written as JSON for tracking regressions.
+//
+//	Usage: ./benchSoRt.exe [--mult 10,100,...] [--jettiness J] [--species pi:K:p:gamma] [--phi-fraction F]
+//	                       [--seed S] [--pool N] [--min-time SEC] [--only NAME,...] [--output bench.json]
+//
+
+// ROOT includes
+#include <TF1.h>
+#include <TMath.h>
+#include <TRandom3.h>
+#include <TString.h>
+#include <TObjArray.h>
+#include <TObjString.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "TransverseSpherocity/TransverseSpherocity.h"
+#include "SpherocityKernel/SpherocityKernel.h"
+#include "EfficiencyModel/EfficiencyModel.h"
+#include "ResonanceFinder/ResonanceFinder.h"
+#include "EventKinematics/EventKinematics.h"
+#include "EstimatorEngine/EstimatorEngine.h"
+
+using namespace std;
+
+typedef std::chrono::steady_clock Clock;
+
+// Particles in the order Pythia would list them, mothers before daughters
+struct SyntheticEvent {
+	vector<Double_t> px, py, pz;
+	vector<Int_t>    pdg;
+	vector<Int_t>    charge3;
+	vector<Int_t>    mother;		// -1 for none
+	vector<Int_t>    nDaughters;
+	vector<UChar_t>  flags;			// EventKinematics bits, kReco drawn with a flat 80% efficiency
+	Int_t nCharged;
+
+	void Clear() { px.clear(); py.clear(); pz.clear(); pdg.clear(); charge3.clear(); mother.clear(); nDaughters.clear(); flags.clear(); nCharged = 0; }
+	Int_t Size() const { return px.size(); }
+};
+
+class SyntheticGenerator {
+ public:
+	SyntheticGenerator(UInt_t seed) : fRandom(seed), fJettiness(0.2), fResonances(0.05) {
+		Double_t mix[4] = { 0.70, 0.12, 0.06, 0.12 };
+		SetSpecies(mix);
+	}
+
+	void SetJettiness(Double_t j) { fJettiness = j; }
+	void SetResonances(Double_t f) { fResonances = f; }
+	void SetSpecies(const Double_t *mix) {	// pi, K, p, gamma, normalised here
+		Double_t sum = 0;
+		for (int i = 0; i < 4; i++) sum += mix[i];
+		for (int i = 0; i < 4; i++) fCumulative[i] = (i ? fCumulative[i-1] : 0.) + mix[i]/sum;
+	}
+
+	// n final-state particles, each phi decay adds its mother on top
+	void Generate(Int_t n, SyntheticEvent& ev) {
+		const Int_t pdgs[4] = { 211, 321, 2212, 22 };
+		ev.Clear();
+		Double_t jetPhi = fRandom.Uniform(0., TMath::TwoPi());
+		Double_t jetEta = fRandom.Uniform(-0.5, 0.5);
+		Int_t nFinal = 0;
+		while (nFinal < n) {
+			Bool_t inJet = fRandom.Uniform() < fJettiness;
+			Int_t side = fRandom.Integer(2);
+			if (n - nFinal >= 2 && fRandom.Uniform() < fResonances) {
+				Int_t iMother = Add(ev, 333, 0, -1, EventKinematics::kHadron, inJet, side, jetPhi, jetEta);
+				ev.nDaughters[iMother] = 2;
+				Add(ev, 321, 3, iMother, EventKinematics::kChargedFinalHadron, inJet, side, jetPhi, jetEta);
+				Add(ev, -321, -3, iMother, EventKinematics::kChargedFinalHadron, inJet, side, jetPhi, jetEta);
+				nFinal += 2;
+				continue;
+			}
+			Double_t u = fRandom.Uniform();
+			Int_t species = 0;
+			while (species < 3 && u > fCumulative[species]) species++;
+			Int_t sign = fRandom.Integer(2) ? 1 : -1;
+			if (species == 3)
+				Add(ev, 22, 0, -1, EventKinematics::kFinal, inJet, side, jetPhi, jetEta);
+			else
+				Add(ev, sign*pdgs[species], 3*sign, -1, EventKinematics::kChargedFinalHadron, inJet, side, jetPhi, jetEta);
+			nFinal++;
+		}
+	}
+
+ private:
+	Int_t Add(SyntheticEvent& ev, Int_t pdg, Int_t charge3, Int_t mother, UChar_t flags,
+			  Bool_t inJet, Int_t side, Double_t jetPhi, Double_t jetEta) {
+		Double_t pt, phi, eta;
+		if (inJet) {	// harder and collimated around the jet axes
+			pt = fRandom.Exp(2.0);
+			phi = jetPhi + side*TMath::Pi() + fRandom.Gaus(0., 0.25);
+			eta = (side ? -jetEta : jetEta) + fRandom.Gaus(0., 0.25);
+		}
+		else {
+			pt = fRandom.Exp(0.5);
+			phi = fRandom.Uniform(0., TMath::TwoPi());
+			eta = fRandom.Uniform(-5., 5.);
+		}
+		if ((flags & EventKinematics::kFinal) && fRandom.Uniform() < 0.8) flags |= EventKinematics::kReco;
+		ev.px.push_back(pt*TMath::Cos(phi));
+		ev.py.push_back(pt*TMath::Sin(phi));
+		ev.pz.push_back(pt*TMath::SinH(eta));
+		ev.pdg.push_back(pdg);
+		ev.charge3.push_back(charge3);
+		ev.mother.push_back(mother);
+		ev.nDaughters.push_back(0);
+		ev.flags.push_back(flags);
+		if (charge3) ev.nCharged++;
+		return ev.Size()-1;
+	}
+
+	TRandom3 fRandom;
+	Double_t fJettiness;
+	Double_t fResonances;
+	Double_t fCumulative[4];
+};
+
+struct BenchResult {
+	TString  name;
+	Int_t    multiplicity;
+	Double_t tracks;		// mean number of tracks the benchmark works on
+	Long64_t calls;
+	Double_t nsPerEvent;
+};
+
+volatile Double_t gSink = 0;	// keeps the compiler from dropping the benchmarked work
+
+// Calls f(event) over the pool in doubling batches until minTime has passed
+template <typename F>
+BenchResult Run(const char* name, const vector<SyntheticEvent>& pool, Int_t multiplicity, Double_t tracks, Double_t minTime, F f) {
+
+	Long64_t calls = 0;
+	Long64_t batch = 1;
+	Double_t sec = 0;
+	Clock::time_point start = Clock::now();
+	while (sec < minTime) {
+		for (Long64_t i = 0; i < batch; i++, calls++) gSink = gSink + f(pool[calls % pool.size()]);
+		sec = std::chrono::duration<Double_t>(Clock::now() - start).count();
+		batch *= 2;
+	}
+
+	BenchResult r = { name, multiplicity, tracks, calls, 1e9*sec/calls };
+	return r;
+}
+
+int main(int argc, const char **argv) {
+
+	vector<Int_t> multiplicities = { 10, 30, 100, 300, 1000, 3000, 10000 };
+	Double_t jettiness = 0.2;
+	Double_t phiFraction = 0.05;
+	Double_t mix[4] = { 0.70, 0.12, 0.06, 0.12 };
+	UInt_t seed = 12345;
+	Int_t poolSize = 32;
+	Double_t minTime = 0.2;
+	TString only = "";
+	TString outputFile = "bench.json";
+	for (int iA = 1; iA < argc; iA++) {
+		TString arg = argv[iA];
+		if (arg == "--mult" && iA+1 < argc) {
+			multiplicities.clear();
+			TObjArray* items = TString(argv[++iA]).Tokenize(",");
+			for (int i = 0; i < items->GetEntriesFast(); i++) multiplicities.push_back(((TObjString*)items->At(i))->String().Atoi());
+			delete items;
+		}
+		else if (arg == "--jettiness" && iA+1 < argc)	jettiness = stod(argv[++iA]);
+		else if (arg == "--phi-fraction" && iA+1 < argc)	phiFraction = stod(argv[++iA]);
+		else if (arg == "--species" && iA+1 < argc) {
+			if (sscanf(argv[++iA], "%lf:%lf:%lf:%lf", &mix[0], &mix[1], &mix[2], &mix[3]) != 4) {
+				cout << "--species needs the fractions pi:K:p:gamma" << endl;
+				return 1;
+			}
+		}
+		else if (arg == "--seed" && iA+1 < argc)		seed = stoul(argv[++iA]);
+		else if (arg == "--pool" && iA+1 < argc)		poolSize = stoi(argv[++iA]);
+		else if (arg == "--min-time" && iA+1 < argc)	minTime = stod(argv[++iA]);
+		else if (arg == "--only" && iA+1 < argc)		only = argv[++iA];
+		else if (arg == "--output" && iA+1 < argc)		outputFile = argv[++iA];
+		else {
+			cout << "Unknown option " << arg << endl;
+			return 1;
+		}
+	}
+	auto selected = [&](const char* name) { return !only.Length() || TString(Form(",%s,", only.Data())).Contains(Form(",%s,", name)); };
+
+	// the same inputs as in makeTreeSoRt, with one flat efficiency shape for all species
+	TF1 fEff("benchEff", "0.8*(1-exp(-x/0.3))", 0., 20.);
+	EfficiencyModel effModel;
+	effModel.AddSpecies(211, &fEff);
+	effModel.AddSpecies(321, &fEff);
+	effModel.AddSpecies(2212, &fEff);
+	ResonanceFinder resonances;
+	resonances.AddChannel(333, 321, 321);
+	resonances.AddChannel(313, 321, 211);
+	resonances.AddChannel(3124, 2212, 321);
+	EstimatorEngine estimators;
+	estimators.AddEstimator("evNchTrans count eta=-0.8:0.8 region=trans lead=gen leadpt=5");
+	estimators.AddEstimator("evNchTransRec count select=final,hadron,charged,reco eta=-0.8:0.8 region=trans lead=rec leadpt=5");
+	estimators.AddEstimator("evNchCL count eta=-0.8:0.8");
+	estimators.AddEstimator("evNchCLRec count select=final,hadron,charged,reco eta=-0.8:0.8");
+	estimators.AddEstimator("evNchV0M count eta=2.8:5.1,-3.7:-1.7");
+
+	TransverseSpherocity TS;
+	TS.SetMinMulti(1);
+	SpherocityKernel SK;
+	SK.SetMinMulti(1);
+	EventKinematics kin;
+	TRandom3 random(seed);
+
+	cout << "Synthetic events: jettiness " << jettiness << ", phi fraction " << phiFraction
+		 << ", species pi:K:p:gamma " << mix[0] << ":" << mix[1] << ":" << mix[2] << ":" << mix[3]
+		 << ", seed " << seed << ", spherocity kernel " << SK.GetIsaName() << endl;
+	printf("%-20s %8s %10s %10s %14s %12s\n", "benchmark", "mult", "tracks", "calls", "ns/event", "ns/track");
+
+	vector<BenchResult> results;
+	auto report = [&](const BenchResult& r) {
+		printf("%-20s %8i %10.1f %10lli %14.1f %12.2f\n", r.name.Data(), r.multiplicity, r.tracks, r.calls, r.nsPerEvent,
+			r.tracks > 0 ? r.nsPerEvent/r.tracks : 0.);
+		results.push_back(r);
+	};
+
+	for (auto mult : multiplicities) {
+
+		// the pool only depends on the seed and the multiplicity
+		SyntheticGenerator generator(seed + mult);
+		generator.SetJettiness(jettiness);
+		generator.SetResonances(phiFraction);
+		generator.SetSpecies(mix);
+		vector<SyntheticEvent> pool(poolSize);
+		Double_t nCharged = 0, nParticles = 0;
+		for (auto& ev : pool) {
+			generator.Generate(mult, ev);
+			nCharged += ev.nCharged;
+			nParticles += ev.Size();
+		}
+		nCharged /= poolSize;
+		nParticles /= poolSize;
+
+		auto fillTS = [&](const SyntheticEvent& ev) {
+			TS.Reset();
+			for (int i = 0; i < ev.Size(); i++) if (ev.charge3[i]) TS.AddTrack(ev.px[i], ev.py[i]);
+		};
+
+		if (selected("spherocity_grid"))
+			report(Run("spherocity_grid", pool, mult, nCharged, minTime, [&](const SyntheticEvent& ev) {
+				fillTS(ev);
+				return TS.GetTransverseSpherocity();
+			}));
+
+		if (selected("spherocity_tracks"))
+			report(Run("spherocity_tracks", pool, mult, nCharged, minTime, [&](const SyntheticEvent& ev) {
+				fillTS(ev);
+				return TS.GetTransverseSpherocityTracks();
+			}));
+
+		if (selected("spherocity_kernel"))
+			report(Run("spherocity_kernel", pool, mult, nCharged, minTime, [&](const SyntheticEvent& ev) {
+				SK.Reset();
+				for (int i = 0; i < ev.Size(); i++)
+					if (ev.charge3[i]) SK.AddTrack(ev.px[i], ev.py[i],
+						(ev.flags[i] & EventKinematics::kReco) ? SpherocityKernel::kMaskGen|SpherocityKernel::kMaskRec : SpherocityKernel::kMaskGen);
+				Float_t so[SpherocityKernel::kNVariants];
+				SK.Compute(so);
+				return (Double_t)so[SpherocityKernel::kGen];
+			}));
+
+		if (selected("efficiency"))
+			report(Run("efficiency", pool, mult, nParticles, minTime, [&](const SyntheticEvent& ev) {
+				Int_t nReco = 0;
+				for (int i = 0; i < ev.Size(); i++) {
+					Double_t mcRec = random.Uniform(0., 1.);
+					Int_t species = effModel.GetSpecies(ev.pdg[i]);
+					Double_t pt = TMath::Sqrt(ev.px[i]*ev.px[i] + ev.py[i]*ev.py[i]);
+					if (species >= 0 && mcRec < effModel.Eval(species, pt)) nReco++;
+				}
+				return (Double_t)nReco;
+			}));
+
+		if (selected("resonances"))
+			report(Run("resonances", pool, mult, nParticles, minTime, [&](const SyntheticEvent& ev) {
+				resonances.Reset(ev.Size());
+				for (int i = 0; i < ev.Size(); i++) {
+					resonances.AddMother(i, i, ev.pdg[i], ev.nDaughters[i]);
+					resonances.AddDaughter(ev.mother[i], ev.pdg[i], ev.flags[i] & EventKinematics::kReco);
+				}
+				Int_t nReco = 0;
+				for (int iC = 0; iC < resonances.GetNCandidates(); iC++)
+					if (resonances.IsComplete(iC) && resonances.IsReco(iC)) nReco++;
+				return (Double_t)nReco;
+			}));
+
+		if (selected("estimators"))
+			report(Run("estimators", pool, mult, nParticles, minTime, [&](const SyntheticEvent& ev) {
+				kin.Reset(ev.Size());
+				for (int i = 0; i < ev.Size(); i++) kin.Set(i, ev.px[i], ev.py[i], ev.pz[i], ev.pdg[i], ev.charge3[i], ev.flags[i]);
+				kin.Compute();
+				Double_t leadPt[EstimatorEngine::kNLeads] = { -1., -1. };
+				Double_t leadPhi[EstimatorEngine::kNLeads] = { 0., 0. };
+				for (int i = 0; i < ev.Size(); i++) {
+					if (!kin.Is(i, EventKinematics::kChargedFinalHadron) || kin.AbsEta(i) >= 0.8) continue;
+					if (kin.Pt(i) > leadPt[0]) { leadPt[0] = kin.Pt(i); leadPhi[0] = kin.Phi(i); }
+					if (kin.Is(i, EventKinematics::kReco) && kin.Pt(i) > leadPt[1]) { leadPt[1] = kin.Pt(i); leadPhi[1] = kin.Phi(i); }
+				}
+				estimators.Compute(kin.GetN(), kin.GetPt(), kin.GetEta(), kin.GetPhi(), kin.GetFlags(), leadPt, leadPhi);
+				return estimators.GetValue(0);
+			}));
+	}
+
+	// one record per benchmark and multiplicity
+	ofstream out(outputFile.Data());
+	if (!out) {
+		cout << "Cannot write " << outputFile << endl;
+		return 1;
+	}
+	out << "{\n  \"config\": { \"jettiness\": " << jettiness << ", \"phiFraction\": " << phiFraction
+		<< ", \"species\": [" << mix[0] << ", " << mix[1] << ", " << mix[2] << ", " << mix[3] << "]"
+		<< ", \"seed\": " << seed << ", \"pool\": " << poolSize << ", \"minTime\": " << minTime
+		<< ", \"kernelIsa\": \"" << SK.GetIsaName() << "\" },\n  \"results\": [\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchResult& r = results[i];
+		out << "    { \"benchmark\": \"" << r.name << "\", \"multiplicity\": " << r.multiplicity
+			<< ", \"tracks\": " << r.tracks << ", \"calls\": " << r.calls
+			<< ", \"nsPerEvent\": " << r.nsPerEvent << ", \"nsPerTrack\": " << (r.tracks > 0 ? r.nsPerEvent/r.tracks : 0.)
+			<< " }" << (i+1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n}\n";
+	cout << "Results written to " << outputFile << endl;
+
+	return 0;
+}
@@ -16,12 +16,38 @@
 #include <TParticle.h>
 #include <TF1.h>
 #include <TRandom3.h>
+#include <TROOT.h>
+#include <RVersion.h>
+#include <ROOT/TBufferMerger.hxx>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
 
 #include "TransverseSpherocity/TransverseSpherocity.h"
+#include "SpherocityKernel/SpherocityKernel.h"
+#include "TrackColumns/TrackColumns.h"
+#include "EfficiencyModel/EfficiencyModel.h"
+#include "ResonanceFinder/ResonanceFinder.h"
+#include "EventKinematics/EventKinematics.h"
+#include "EstimatorEngine/EstimatorEngine.h"
+#include "AnalysisTask/AnalysisTask.h"
+#include "SoRtSpectra/SoRtSpectra.h"
+#include "AsyncTreeWriter/AsyncTreeWriter.h"
 
 using namespace std;
 using namespace Pythia8;
 
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,26,0)
+using ROOT::TBufferMerger;
+using ROOT::TBufferMergerFile;
+#else
+using ROOT::Experimental::TBufferMerger;
+using ROOT::Experimental::TBufferMergerFile;
+#endif
+
 const int nStrange = 7;
 const int strangePDGs[nStrange] = 
 	{310, 313, 333, 3122, 3312,
@@ -31,59 +57,263 @@ bool isStrange(Int_t pdg) {
 		if ( TMath::Abs(pdg) == strangePDGs[iS] ) return true;	}
 	return false;
 }
-double DeltaPhi(Double_t phi1, Double_t phi2) {
-	
-	Double_t dphi = phi2 - phi1;
-	if ( dphi > TMath::Pi() )		dphi = dphi - 2*TMath::Pi();
-	if ( dphi < -1.*TMath::Pi() )	dphi = dphi + 2*TMath::Pi();
-
-	return dphi;
-}
-
-bool IsTrans(Double_t phi1, Double_t phiTrig) {
-
-	Double_t dphi = DeltaPhi(phi1,phiTrig);
-	if (TMath::Abs(dphi) < TMath::Pi()/3.) 		return false;
-	if (TMath::Abs(dphi) > 2.*TMath::Pi()/3.) 	return false;
-	
-	return true;
+// Hands out the events in chunks, so that faster threads pick up more of them
+class EventDispenser {
+ public:
+	EventDispenser(Int_t nEvents, Int_t chunkSize) : fNext(0), fTotal(nEvents), fChunk(chunkSize) {}
+	bool Next(Int_t& first, Int_t& last) {
+		first = fNext.fetch_add(fChunk);
+		if (first >= fTotal) return false;
+		last = TMath::Min(first + fChunk, fTotal);
+		return true;
+	}
+ private:
+	std::atomic<Int_t> fNext;
+	const Int_t fTotal;
+	const Int_t fChunk;
+};
+
+// Per-thread seeds are seed*kMaxThreads + thread + 1, so productions with different
+// --seed never share a random stream and the largest stays within Pythia's 900000000
+const Int_t kMaxThreads = 1000;
+const Int_t kMaxSeed = 900000000/kMaxThreads - 1;
+Int_t ThreadSeed(Int_t seed, Int_t iThread) { return seed*kMaxThreads + iThread + 1; }
+
+// In-generator analysis tasks by name, 0 if unknown
+AnalysisTask* MakeTask(const TString& name) {
+	if (name == "SoRtSpectra") return new SoRtSpectra();
+	return 0;
 }
 
-int WhatRegion(Double_t phi1, Double_t phiTrig) {
-
-	Double_t dphi = DeltaPhi(phi1,phiTrig);
-	
-	if (TMath::Abs(dphi) < TMath::Pi()/3.)			return 1;
-	else if (TMath::Abs(dphi) > 2.*TMath::Pi()/3.) 	return 2;
-	else return 0;
-}
+// Rt-enhanced production: vetoes events after the parton level (before hadronisation and decays)
+// if the final partons within the eta window together carry less pT than the cut. A leading
+// hadron can collect momentum from several partons, but not more than their scalar sum, so
+// only events that cannot pass the cut are vetoed (up to partons migrating into the window).
+// In a dry run nothing is vetoed and WouldVeto() tells whether the current event would have been.
+class LeadingPartonVeto : public UserHooks {
+ public:
+	LeadingPartonVeto(Double_t ptMin, Double_t etaMax, Bool_t dryRun) 
+		: fPtMin(ptMin), fEtaMax(etaMax), fDryRun(dryRun), fWouldVeto(false), fNtried(0), fNvetoed(0) {}
+	bool canVetoPartonLevel() { return true; }
+	bool doVetoPartonLevel(const Event& event) {
+		fNtried++;
+		Double_t sumPt = 0;
+		for (int iP = 0; iP < event.size(); ++iP) {
+			const Particle& p = event[iP];
+			if (p.isFinal() && p.isParton() && TMath::Abs(p.eta()) < fEtaMax) sumPt += p.pT();
+		}
+		fWouldVeto = sumPt < fPtMin;
+		if (fWouldVeto) fNvetoed++;
+		return fWouldVeto && !fDryRun;
+	}
+	Bool_t WouldVeto() const { return fWouldVeto; }
+	Long64_t GetNTried() const { return fNtried; }
+	Long64_t GetNVetoed() const { return fNvetoed; }
+ private:
+	Double_t fPtMin;
+	Double_t fEtaMax;
+	Bool_t   fDryRun;
+	Bool_t   fWouldVeto;
+	Long64_t fNtried;
+	Long64_t fNvetoed;
+};
 
 int main(int argc, const char **argv) {
 
+	// positional arguments: nEvents, output file, showInfo
+	// options: --threads N, --seed S (0 to 899999, from /dev/urandom if not given; thread i uses seed 1000*S+i+1), --chunk C (events handed out at once)
+	//          --columnar (flat track arrays instead of TParticles), --precision B (mantissa bits of columnar momenta)
+	//          --resonances F (decay channel table, lines of "mother daughter1 daughter2 ...")
+	//          --estimators F (estimator definitions, see EstimatorEngine.h and estimators.cfg; the
+	//          default estimators missing from F are added)
+	//          --task NAME (in-generator analysis, can be repeated: SoRtSpectra)
+	//          --tree full|events|none (which trees are written, events: no track tree)
+	//          --compression ALG:LEVEL (zlib, lzma, lz4 or zstd), --basket-size B (bytes per branch),
+	//          --autoflush N (cluster size, N > 0 entries, N < 0 bytes), --imt N (ROOT implicit MT
+	//          threads compressing the baskets), --async (trees filled on a writer thread per generator thread)
+	//          --enhance-rt (pTHatMin bias and parton level veto on the leading pT), --veto-fraction F
+	//          (the veto keeps events whose final partons sum to F*ptLeadCut in pT, 0 switches the veto off),
+	//          --veto-dry-run (nothing is vetoed, hGenStat counts the events the veto would lose)
+	Int_t nThreads = 1;
+	Int_t seed = 0;
+	Bool_t seedGiven = false;
+	Int_t chunkSize = 100;
+	Bool_t columnar = false;
+	Int_t precision = 12;
+	TString resonanceFile = "";
+	TString estimatorFile = "";
+	Bool_t enhanceRt = false;
+	Double_t vetoFraction = 1.;
+	Bool_t vetoDryRun = false;
+	std::vector<TString> taskNames;
+	TString treeMode = "full";
+	TString compression = "";
+	Int_t basketSize = 0;
+	Long64_t autoFlush = 0;
+	Int_t imtThreads = -1;
+	Bool_t asyncWrite = false;
+	std::vector<const char*> args = { argv[0] };
+	for (int iA = 1; iA < argc; iA++) {
+		TString arg = argv[iA];
+		if (arg == "--threads" && iA+1 < argc)		nThreads = stoi(argv[++iA]);
+		else if (arg == "--seed" && iA+1 < argc)	{ seed = stoi(argv[++iA]); seedGiven = true; }
+		else if (arg == "--chunk" && iA+1 < argc)	chunkSize = stoi(argv[++iA]);
+		else if (arg == "--columnar")				columnar = true;
+		else if (arg == "--precision" && iA+1 < argc)	precision = stoi(argv[++iA]);
+		else if (arg == "--resonances" && iA+1 < argc)	resonanceFile = argv[++iA];
+		else if (arg == "--estimators" && iA+1 < argc)	estimatorFile = argv[++iA];
+		else if (arg == "--task" && iA+1 < argc)	taskNames.push_back(argv[++iA]);
+		else if (arg == "--tree" && iA+1 < argc)	treeMode = argv[++iA];
+		else if (arg == "--compression" && iA+1 < argc)	compression = argv[++iA];
+		else if (arg == "--basket-size" && iA+1 < argc)	basketSize = stoi(argv[++iA]);
+		else if (arg == "--autoflush" && iA+1 < argc)	autoFlush = stoll(argv[++iA]);
+		else if (arg == "--imt" && iA+1 < argc)		imtThreads = stoi(argv[++iA]);
+		else if (arg == "--async")					asyncWrite = true;
+		else if (arg == "--enhance-rt")				enhanceRt = true;
+		else if (arg == "--veto-fraction" && iA+1 < argc)	vetoFraction = stod(argv[++iA]);
+		else if (arg == "--veto-dry-run")			vetoDryRun = true;
+		else args.push_back(argv[iA]);
+	}
+
 	const char *defaults[6] = {"","2000","pytest.root","1"};
-	if ( argc < 3 ) {
-		argv = defaults;
-		argc = 3;
+	if ( args.size() < 3 ) {
+		args.assign(defaults, defaults+4);
 		cout << "Using default arguments..." << endl;
 	}
+	if ( args.size() < 4 ) args.push_back("0");
 
-	Int_t nEvents = stoi(argv[1]);// InFileName = argv[0];
+	Int_t nEvents = stoi(args[1]);// InFileName = argv[0];
 	cout << "Number of events: " << nEvents << endl;
 	
-	TString OutFileName = argv[2];
+	TString OutFileName = args[2];
 	cout << "Output file is "<< OutFileName.Data() << endl;
 
-	Bool_t showInfo = (Bool_t)stoi(argv[3]);
+	Bool_t showInfo = (Bool_t)stoi(args[3]);
 	cout << "showInfo is " << showInfo << endl;
 
-	// Set up output file
-	TFile * fout = new TFile(OutFileName.Data(), "RECREATE");
+	if (nThreads < 1) nThreads = 1;
+	if (nThreads > kMaxThreads) {
+		cout << "At most " << kMaxThreads << " threads are supported" << endl;
+		return 1;
+	}
+	if (chunkSize < 1) chunkSize = 1;
+	if (seed < 0 || seed > kMaxSeed) {
+		cout << "--seed " << seed << " is outside 0 to " << kMaxSeed << endl;
+		return 1;
+	}
+	if (!seedGiven) {
+		seed = std::random_device()() % (kMaxSeed + 1);
+		cout << "No --seed given, using " << seed << " from /dev/urandom (pass --seed " << seed << " to repeat this production)" << endl;
+	}
+	cout << "Threads: " << nThreads << ", seed: " << seed << endl;
+	if (columnar) cout << "Writing columnar tracks with " << precision << " mantissa bits" << endl;
+	if (treeMode != "full" && treeMode != "events" && treeMode != "none") {
+		cout << "Unknown --tree " << treeMode << ", use full, events or none" << endl;
+		return 1;
+	}
+	for (auto& name : taskNames) {
+		std::unique_ptr<AnalysisTask> task(MakeTask(name));
+		if (!task) {
+			cout << "Unknown --task " << name << endl;
+			return 1;
+		}
+		cout << "Analysis task: " << name << endl;
+	}
+
+	// resonance decay channels from --resonances, by default phi -> K+ K- only as before
+	// (resonances.cfg adds K*0 and Lambda(1520))
+	auto setUpResonances = [&](ResonanceFinder& finder) -> Bool_t {
+		if (resonanceFile.Length()) return finder.ReadChannels(resonanceFile.Data());
+		finder.AddChannel(333, 321, 321);		// phi -> K+ K-
+		return true;
+	};
+	{
+		ResonanceFinder resonances;
+		if (!setUpResonances(resonances)) {
+			cout << "Cannot read the decay channels from --resonances " << resonanceFile << endl;
+			return 1;
+		}
+		if (resonanceFile.Length()) cout << "Resonances: " << resonances.GetNChannels() << " decay channels from " << resonanceFile << endl;
+	}
 
 	// Analysis parameters
-	const Bool_t enhanceRt = false;
 	const Int_t minTracks = 10;
 	const Float_t cutEta = 0.8;
 	const Float_t ptLeadCut = 5.0;
+
+	// multiplicity estimators from --estimators, completed by the original ones
+	// which the readers use (evNchCLRec in the event selection, evNchV0M, ...)
+	auto setUpEstimators = [&](EstimatorEngine& engine) -> Bool_t {
+		if (estimatorFile.Length() && !engine.ReadConfig(estimatorFile.Data())) return false;
+		const TString defaults[] = {
+			Form("evNchTrans count eta=%g:%g region=trans lead=gen leadpt=%g", -cutEta, cutEta, ptLeadCut),
+			Form("evNchTransRec count select=final,hadron,charged,reco eta=%g:%g region=trans lead=rec leadpt=%g", -cutEta, cutEta, ptLeadCut),
+			"evNchCL count eta=-0.8:0.8",
+			"evNchCLRec count select=final,hadron,charged,reco eta=-0.8:0.8",
+			"evNchV0M count eta=2.8:5.1,-3.7:-1.7" };
+		for (auto& definition : defaults) {
+			TString name = definition(0, definition.Index(" "));
+			if (engine.FindEstimator(name) >= 0) continue;
+			if (engine.AddEstimator(definition) < 0) return false;
+		}
+		return true;
+	};
+	{
+		EstimatorEngine estimators;
+		if (!setUpEstimators(estimators)) {
+			cout << "Cannot set up the estimators from --estimators " << estimatorFile << endl;
+			return 1;
+		}
+		if (estimatorFile.Length()) cout << "Estimators: " << estimators.GetNEstimators() << " from " << estimatorFile << " and the defaults" << endl;
+	}
+	const Bool_t writeTracks = treeMode == "full";
+	const Bool_t writeEvents = treeMode != "none";
+	if (!writeTracks) cout << "Not writing the track tree" << (writeEvents ? "" : " and the event tree") << endl;
+
+	// output tuning: compression as 100*algorithm + level (ROOT::RCompressionSetting)
+	Int_t compressionSettings = -1;
+	if (compression.Length()) {
+		const char* algNames[] = { "zlib", "lzma", "old", "lz4", "zstd" };
+		Ssiz_t colon = compression.Index(":");
+		TString alg = colon < 0 ? compression : TString(compression(0, colon));
+		Int_t level = colon < 0 ? 1 : TString(compression(colon+1, compression.Length())).Atoi();
+		for (int iAlg = 0; iAlg < 5; iAlg++) if (alg == algNames[iAlg]) compressionSettings = 100*(iAlg+1) + level;
+		if (compressionSettings < 0 || level < 0 || level > 9) {
+			cout << "Unknown --compression " << compression << ", use zlib, lzma, lz4 or zstd with level 0-9" << endl;
+			return 1;
+		}
+		cout << "Compression " << alg << " level " << level << endl;
+	}
+	if (asyncWrite && writeTracks && !columnar) {
+		cout << "--async needs leaf-list branches, use it with --columnar or --tree events/none" << endl;
+		return 1;
+	}
+	if (imtThreads >= 0) {
+		ROOT::EnableImplicitMT(imtThreads);
+		cout << "Implicit MT for basket compression with " << ROOT::GetImplicitMTPoolSize() << " threads" << endl;
+	}
+	if (asyncWrite) cout << "Filling the trees on writer threads" << endl;
+	if (enhanceRt) cout << "Rt-enhanced production, parton level veto at " << vetoFraction << " of the leading pT cut"
+		<< (vetoDryRun ? " (dry run, nothing is vetoed)" : "") << endl;
+
+	// Set up output file, threads write through a merger into the same file
+	TFile * fout = 0;
+	std::unique_ptr<TBufferMerger> merger;
+	std::shared_ptr<TBufferMergerFile> mainFile;
+	if (nThreads > 1 || asyncWrite) ROOT::EnableThreadSafety();
+	if (nThreads > 1) {
+		if (compressionSettings >= 0) merger.reset(new TBufferMerger(OutFileName.Data(), "RECREATE", compressionSettings));
+		else merger.reset(new TBufferMerger(OutFileName.Data(), "RECREATE"));
+		merger->SetAutoSave(32*1024*1024);
+		mainFile = merger->GetFile();
+		mainFile->cd();
+	}
+	else {
+		fout = new TFile(OutFileName.Data(), "RECREATE");
+		if (compressionSettings >= 0) fout->SetCompressionSettings(compressionSettings);
+	}
+
+	// Tracking efficiencies
 	enum { pi, k, p, k0s, l, xi, phi, partSize};
 	int PDGs[partSize] = { 211, 321, 2212, 310, 3122, 3312, 333 };
 	TF1* pEffi[partSize];
@@ -102,253 +332,380 @@ int main(int argc, const char **argv) {
 	pEffi[phi]	= new TF1("pEffi_phi","([0]*x^[1]*exp(-x) - [2]*x +[3])*(x>[4])", 0, 20);
 	pEffi[phi]->SetParameters(-5.25411e-01,5.42076e-02,-2.99137e-03,3.03124e-01,2.77814e-02); 
 	for (int iF = 0; iF < partSize; iF++) pEffi[iF]->Write();
+	if (mainFile) mainFile->Write();
 
+	// every thread tabulates its own copy of the efficiencies
+	std::vector<std::vector<TF1*> > pEffiThreads(nThreads);
+	for (int iT = 0; iT < nThreads; iT++)
+	for (int iF = 0; iF < partSize; iF++)
+		pEffiThreads[iT].push_back(iT ? (TF1*)pEffi[iF]->Clone(Form("%s_%i",pEffi[iF]->GetName(),iT)) : pEffi[iF]);
 
-  	// Initialize PYTHIA minbias Generator.
-	Pythia8::Pythia pythia;
-	pythia.readString("Beams:eCM = 13000."); // 7 TeV pp
-  	if (enhanceRt) pythia.readString("PhaseSpace:pTHatMin = 4.5");
-  	/*
-	SoftQCD:all = on                   ! Allow total sigma = elastic/SD/DD/ND
-	Optionally only study one or a few processes at a time.
-	SoftQCD:elastic = on               ! Elastic
-	SoftQCD:singleDiffractive = on     ! Single diffractive
-	SoftQCD:doubleDiffractive = on     ! Double diffractive
-	SoftQCD:centralDiffractive = on    ! Central diffractive
-	SoftQCD:nonDiffractive = on        ! Nondiffractive (inelastic)
-	SoftQCD:inelastic = on             ! All inelastic
-   	*/
-	pythia.readString("SoftQCD:nonDiffractive = on");    
-	pythia.readString("SoftQCD:doubleDiffractive = on");   
-	pythia.readString("Random:setSeed = on");
-	pythia.readString("Random:seed = 0");
-
-	pythia.init();
-
-	// Create histograms and other analysis objects
 	enum { gen , genNoPt, rec, recNoPt, TSsize};
 	const char* TSnames[TSsize] = { "gen" , "genNoPt", "rec", "recNoPt"};
-	TransverseSpherocity* TS[TSsize];
-	for (int iTS = 0; iTS < TSsize; iTS++)	{
-		TS[iTS] = new TransverseSpherocity();
-		TS[iTS]->SetMinMulti(minTracks);
-	}
-	TRandom3* random = new TRandom3();
-
-	// Create tree and branches
-	TTree* tree = new TTree("tree", "PYTHIA Track Tree");
-	const Int_t maxSize = 10e3;					// max size of particle arrays / event
-	TClonesArray trackArray("TParticle", maxSize);
-	tree->Branch("tracks", &trackArray);		// why bronch?
-    Float_t evSo[TSsize];
-    for (int iTS = 0; iTS < TSsize; iTS++)	{
-    	tree->Branch(Form("evSo%s",TSnames[iTS]),&evSo[iTS],
-    		Form("evSo%s/f",TSnames[iTS]));
-    }
-    Float_t evPtLeadgen;
-    tree->Branch("evPtLeadgen", &evPtLeadgen, "evPtLeadgen/F");
-    Float_t evPhiLeadgen;
-    tree->Branch("evPhiLeadgen", &evPhiLeadgen, "evPhiLeadgen/F");
-    Float_t evEtaLeadgen;
-    tree->Branch("evEtaLeadgen", &evEtaLeadgen, "evEtaLeadgen/F");
-    Float_t evPtLeadrec;
-    tree->Branch("evPtLeadrec", &evPtLeadrec, "evPtLeadrec/F");
-    Float_t evPhiLeadrec;
-    tree->Branch("evPhiLeadrec", &evPhiLeadrec, "evPhiLeadrec/F");
-    Float_t evEtaLeadrec;
-    tree->Branch("evEtaLeadrec", &evEtaLeadrec, "evEtaLeadrec/F");
-    Int_t evNchTrans;
-    tree->Branch("evNchTrans", &evNchTrans, "evNchTrans/I");
-    Int_t evNchTransRec;
-    tree->Branch("evNchTransRec", &evNchTransRec, "evNchTransRec/I");
-    Int_t evNchCL;
-    tree->Branch("evNchCL", &evNchCL, "evNchCL/I");
-    Int_t evNchCLRec;
-    tree->Branch("evNchCLRec", &evNchCLRec, "evNchCLRec/I");
-    Int_t evNchV0M;
-    tree->Branch("evNchV0M", &evNchV0M, "evNchV0M/I");
-
-	// Event loop
-	int   nRealEvents = 0;
-	for (int iEvent = 0; iEvent < nEvents; ++iEvent)	{
-	
-		int nTr  = 0;
-		if (!pythia.next()) continue;
-		nRealEvents++;
-
-		trackArray.Clear();
-		for (int iTS = 0; iTS < TSsize; iTS++) {
-			TS[iTS]->Reset();
-			evSo[iTS] = -1;
+	EventDispenser dispenser(nEvents, chunkSize);
+	std::mutex printMutex;
+
+	// time per stage summed over the threads, printed in the summary
+	enum { kNext, kAnalysis, kFill, kWrite, kNStages };
+	const char* stageNames[kNStages] = { "Pythia next()", "analysis", "Fill", "write" };
+	Double_t stageSec[kNStages] = { 0 };
+	typedef std::chrono::steady_clock Clock;
+	auto seconds = [](Clock::time_point t0, Clock::time_point t1) { return std::chrono::duration<Double_t>(t1 - t0).count(); };
+	Clock::time_point tStart = Clock::now();
+
+	// Generate and analyse events on one thread, returns the number of accepted events
+	auto generate = [&](Int_t iThread, TDirectory* outDir) -> Int_t {
+
+		// pi, k, p match both charges, the v0s and cascades only particles (as before)
+		TF1** pEffiThread = pEffiThreads[iThread].data();
+		EfficiencyModel effModel;
+		for (int iPdg = 0; iPdg < partSize-1; iPdg++) effModel.AddSpecies(PDGs[iPdg], pEffiThread[iPdg], iPdg < k0s);
+
+		// resonances with daughters reconstructed as primaries, the mothers are always saved
+		ResonanceFinder resonances;
+		setUpResonances(resonances);	// checked in main() already
+
+	  	// Initialize PYTHIA minbias Generator.
+		Pythia8::Pythia pythia;
+		pythia.readString("Beams:eCM = 13000."); // 7 TeV pp
+	  	if (enhanceRt) pythia.readString("PhaseSpace:pTHatMin = 4.5");
+	  	/*
+		SoftQCD:all = on                   ! Allow total sigma = elastic/SD/DD/ND
+		Optionally only study one or a few processes at a time.
+		SoftQCD:elastic = on               ! Elastic
+		SoftQCD:singleDiffractive = on     ! Single diffractive
+		SoftQCD:doubleDiffractive = on     ! Double diffractive
+		SoftQCD:centralDiffractive = on    ! Central diffractive
+		SoftQCD:nonDiffractive = on        ! Nondiffractive (inelastic)
+		SoftQCD:inelastic = on             ! All inelastic
+	   	*/
+		pythia.readString("SoftQCD:nonDiffractive = on");    
+		pythia.readString("SoftQCD:doubleDiffractive = on");   
+		pythia.readString("Random:setSeed = on");
+		pythia.readString(Form("Random:seed = %i", ThreadSeed(seed, iThread)));
+
+		// vetoed events are regenerated inside pythia.next(), only the accepted ones reach the tree
+#if PYTHIA_VERSION_INTEGER >= 8300
+		auto veto = make_shared<LeadingPartonVeto>(vetoFraction*ptLeadCut, cutEta + 1., vetoDryRun);
+		if (enhanceRt && vetoFraction > 0) pythia.setUserHooksPtr(veto);
+#else
+		LeadingPartonVeto vetoHook(vetoFraction*ptLeadCut, cutEta + 1., vetoDryRun);
+		LeadingPartonVeto* veto = &vetoHook;
+		if (enhanceRt && vetoFraction > 0) pythia.setUserHooksPtr(veto);
+#endif
+
+		pythia.init();
+
+		// Create histograms and other analysis objects
+		SpherocityKernel SK;	// all four TSnames variants in one pass
+		SK.SetMinMulti(minTracks);
+		EventKinematics kin;	// per-event cache of pT, eta, phi and status bits
+
+		// multiplicity estimators, checked in main() already
+		EstimatorEngine estimators;
+		setUpEstimators(estimators);
+		std::vector<std::unique_ptr<AnalysisTask> > tasks;
+		for (auto& name : taskNames) {
+			tasks.emplace_back(MakeTask(name));
+			tasks.back()->Init(outDir);
+		}
+		if (!iThread) cout << "Spherocity kernel instruction set: " << SK.GetIsaName() << endl;
+		TRandom3 random(ThreadSeed(seed, iThread));
+
+		// Create tree and branches
+		outDir->cd();
+		TTree* tree = new TTree("tree", "PYTHIA Track Tree");
+		const Int_t maxSize = 10e3;					// max size of particle arrays / event
+		TClonesArray trackArray("TParticle", maxSize);
+		TrackColumns columns(maxSize);
+		if (!writeTracks) tree->SetDirectory(0);
+		else if (columnar) columns.MakeBranches(tree, precision);
+		else tree->Branch("tracks", &trackArray);		// why bronch?
+	    // event summary, aligned by entry with the track tree (can be added as a friend)
+	    TTree* events = new TTree("events", "PYTHIA Event Summary");
+	    if (!writeEvents) events->SetDirectory(0);
+	    Float_t evSo[TSsize];
+	    for (int iTS = 0; iTS < TSsize; iTS++)	{
+	    	events->Branch(Form("evSo%s",TSnames[iTS]),&evSo[iTS],
+	    		Form("evSo%s/f",TSnames[iTS]));
+	    }
+	    // spherocity distributions, the readers take the quantile cuts from these
+	    TH1D* hEvSo[TSsize];
+	    for (int iTS = 0; iTS < TSsize; iTS++)	{
+	    	hEvSo[iTS] = new TH1D(Form("hEvSo_%s",TSnames[iTS]),"",1000,0.,1.);
+	    }
+	    // generation statistics, summed over the threads (and over files by hadd)
+	    TH1D* hGenStat = new TH1D("hGenStat", "Generation statistics", 6, 0, 6);
+	    const char* genStatLabels[6] = { "vetoed", "accepted", "sum of weights", "sigmaGen*accepted [mb]",
+	    	"dry run: would be vetoed", "dry run: would be vetoed, pT lead > cut" };
+	    for (int iB = 0; iB < 6; iB++) hGenStat->GetXaxis()->SetBinLabel(iB+1, genStatLabels[iB]);
+	    Float_t evWeight;
+	    events->Branch("evWeight", &evWeight, "evWeight/F");
+	    Float_t evPtLeadgen;
+	    events->Branch("evPtLeadgen", &evPtLeadgen, "evPtLeadgen/F");
+	    Float_t evPhiLeadgen;
+	    events->Branch("evPhiLeadgen", &evPhiLeadgen, "evPhiLeadgen/F");
+	    Float_t evEtaLeadgen;
+	    events->Branch("evEtaLeadgen", &evEtaLeadgen, "evEtaLeadgen/F");
+	    Float_t evPtLeadrec;
+	    events->Branch("evPtLeadrec", &evPtLeadrec, "evPtLeadrec/F");
+	    Float_t evPhiLeadrec;
+	    events->Branch("evPhiLeadrec", &evPhiLeadrec, "evPhiLeadrec/F");
+	    Float_t evEtaLeadrec;
+	    events->Branch("evEtaLeadrec", &evEtaLeadrec, "evEtaLeadrec/F");
+	    estimators.MakeBranches(events);
+
+		// with --async the trees above only describe the branches, the writer fills copies of them
+		AsyncTreeWriter writer;
+		Int_t iTreeOut = -1, iEventsOut = -1;
+		if (asyncWrite) {
+			tree->SetDirectory(0);
+			events->SetDirectory(0);
+			if (writeTracks) iTreeOut = writer.Add(tree, outDir);
+			if (writeEvents) iEventsOut = writer.Add(events, outDir);
+			if ((writeTracks && iTreeOut < 0) || (writeEvents && iEventsOut < 0)) return 0;
 		}
-		evPtLeadgen = -1.; evPhiLeadgen = 0; evEtaLeadgen = 0;
-		evPtLeadrec = -1.; evPhiLeadrec = 0; evEtaLeadrec = 0;
-		evNchTrans = -1; evNchTransRec = -1;
-		evNchCL = -1; evNchCLRec = -1;
-		evNchV0M = -1; 
-
-		Int_t nChargedFinal = 0;
-		Int_t nChargedFinalRec = 0;
-		Int_t nTransCh = 0;
-		Int_t nTransChRec = 0;
-		Int_t nChCL = 0;
-		Int_t nChCLRec = 0;
-		Int_t nChV0M = 0;
-		std::vector<Double_t> angles;
-		std::vector<Double_t> anglesRec;
-		std::vector<Int_t> vecPhiDaughters;
-
-		// Particle loop
-		for (int iP = 0; iP < pythia.event.size(); ++iP)	{
+		TTree* outTrees[2] = { writeTracks ? (asyncWrite ? writer.GetTree(iTreeOut) : tree) : 0,
+							   writeEvents ? (asyncWrite ? writer.GetTree(iEventsOut) : events) : 0 };
+		for (auto t : outTrees) {
+			if (!t) continue;
+			if (basketSize > 0) t->SetBasketSize("*", basketSize);
+			if (autoFlush) t->SetAutoFlush(autoFlush);
+		}
+		if (asyncWrite) writer.Start();
+
+		// Event loop
+		int   nRealEvents = 0;
+		Double_t sec[kNStages] = { 0 };
+		Int_t firstEvent, lastEvent;
+		while (dispenser.Next(firstEvent, lastEvent))	// take the next chunk of events
+		for (int iEvent = firstEvent; iEvent < lastEvent; ++iEvent)	{
+	
+			int nTr  = 0;
+			Clock::time_point tNext = Clock::now();
+			if (!pythia.next()) { sec[kNext] += seconds(tNext, Clock::now()); continue; }
+			Clock::time_point tAnalysis = Clock::now();
+			sec[kNext] += seconds(tNext, tAnalysis);
+			nRealEvents++;
+
+			trackArray.Clear();
+			columns.Reset();
+			SK.Reset();
+			for (int iTS = 0; iTS < TSsize; iTS++) evSo[iTS] = -1;
+			evPtLeadgen = -1.; evPhiLeadgen = 0; evEtaLeadgen = 0;
+			evPtLeadrec = -1.; evPhiLeadrec = 0; evEtaLeadrec = 0;
+
+			Int_t nChargedFinal = 0;
+			Int_t nChargedFinalRec = 0;
+			resonances.Reset(pythia.event.size());
+			std::vector<Int_t> savedIndex;	// event index -> saved track index, columnar only
+			if (columnar) savedIndex.assign(pythia.event.size(), -1);
+
+			// cache the kinematics of the whole event, the selections below only read the cache
+			kin.Reset(pythia.event.size());
+			for (int iP = 0; iP < pythia.event.size(); ++iP)	{
+				const Particle& p = pythia.event[iP];
+				kin.Set(iP, p.px(), p.py(), p.pz(), p.id(), p.chargeType(),
+					(p.isFinal() ? EventKinematics::kFinal : 0) | (p.isHadron() ? EventKinematics::kHadron : 0)
+					| (p.isCharged() ? EventKinematics::kCharged : 0));
+			}
+			kin.Compute();
+
+			// Particle loop
+			for (int iP = 0; iP < pythia.event.size(); ++iP)	{
 	  
-	  		Particle& p = pythia.event[iP];
+		  		Particle& p = pythia.event[iP];
 	  	
-	  		Bool_t saveTrack = false;
-	  		if (p.isFinal())	saveTrack = true;				//save final-state charged: pi+-, K+-, p, e
-																//save final-state neutrals: gamma, K0L, n
-	  		if ( isStrange(p.id()) ) 	saveTrack = true;		//save final-state strangeness: phi, K0s, L, Xi, Omega
-	  		if (TMath::Abs(p.id()) == 111)	saveTrack = true;	// save also pi0
-	  		if (!saveTrack) continue;	
+		  		Bool_t saveTrack = false;
+		  		if (p.isFinal())	saveTrack = true;				//save final-state charged: pi+-, K+-, p, e
+																	//save final-state neutrals: gamma, K0L, n
+		  		if ( isStrange(p.id()) ) 	saveTrack = true;		//save final-state strangeness: phi, K0s, L, Xi, Omega
+		  		if (TMath::Abs(p.id()) == 111)	saveTrack = true;	// save also pi0
+		  		if (resonances.GetChannel(p.id()) >= 0)	saveTrack = true;
+		  		if (!saveTrack) continue;	
 	  		
-			TParticle* track =	new( trackArray[nTr++] ) TParticle();
-			track->SetPdgCode(p.id());
-			track->SetFirstMother(p.mother1());
-	  		track->SetLastMother(p.mother2());	
-	  		track->SetFirstDaughter(p.daughter1());
-	  		track->SetLastDaughter(p.daughter2());	
-			track->SetMomentum(p.px(), p.py(), p.pz(), p.e());
-			track->SetProductionVertex(p.xProd(), p.yProd(), p.zProd(), p.tProd());
-
-			// generated
-			// calculate spherocities, multiplicities
-			Bool_t chargedFinal = p.isFinal() && p.isHadron() && p.isCharged() && (TMath::Abs(p.eta())<cutEta);
-			if (chargedFinal) {
-				nChargedFinal++;
-				TS[gen]->AddTrack(p.px(), p.py());
-				if (p.pT()>0) TS[genNoPt]->AddTrack(p.px()/p.pT(), p.py()/p.pT());
-			}
+				TParticle* track = 0;
+				Int_t iColumn = -1;
+				if (!writeTracks) nTr++;
+				else if (columnar) {
+					Int_t mother = (p.mother1() > 0) ? savedIndex[p.mother1()] : -1;
+					iColumn = columns.AddTrack(kin.Px(iP), kin.Py(iP), p.pz(), p.id(), kin.Charge3(iP), mother,
+						kin.Is(iP, EventKinematics::kFinal) ? TrackColumns::kFinal : 0);
+					savedIndex[iP] = iColumn;
+					nTr++;
+				}
+				else {
+					track =	new( trackArray[nTr++] ) TParticle();
+					track->SetPdgCode(p.id());
+					track->SetFirstMother(p.mother1());
+			  		track->SetLastMother(p.mother2());	
+			  		track->SetFirstDaughter(p.daughter1());
+			  		track->SetLastDaughter(p.daughter2());	
+					track->SetMomentum(p.px(), p.py(), p.pz(), p.e());
+					track->SetProductionVertex(p.xProd(), p.yProd(), p.zProd(), p.tProd());
+				}
 
-			// apply efficiency
-			Double_t mcRec = random->Uniform(0.,1.);
-			Bool_t isReco = false;
-			for (int iPdg = 0; iPdg < 3; iPdg++) {	// for pi,k,p only, non-finals need a different approach
-				if (TMath::Abs(p.id())!=PDGs[iPdg]) continue;
-				isReco = ( mcRec < pEffi[iPdg]->Eval(p.pT()) );
-				isReco = isReco && (TMath::Abs(p.eta())<cutEta);
+				// generated
+				// calculate spherocities, multiplicities
+				Bool_t chargedFinal = kin.Is(iP, EventKinematics::kChargedFinalHadron) && (kin.AbsEta(iP)<cutEta);
+				if (chargedFinal) nChargedFinal++;
+
+				// apply efficiency
+				// pi,k,p as primaries; v0s, cascades (daughters not reconstructable as primary)
+				Double_t mcRec = random.Uniform(0.,1.);
+				Int_t species = effModel.GetSpecies(p.id());
+				Bool_t isReco = species >= 0 && ( mcRec < effModel.Eval(species, kin.Pt(iP)) );
+				isReco = isReco && (kin.AbsEta(iP)<cutEta);
+				kin.SetReco(iP, isReco);
 				
-				if (iPdg == k && (TMath::Abs(pythia.event[p.mother1()].id()) == PDGs[phi]
-					&& p.mother2() == 0) ) 
-						vecPhiDaughters.push_back(nTr-1);
-			}
+				// resonances (daughters reconstructed as primaries)
+				Int_t iSaved = columnar ? iColumn : nTr-1;
+				Int_t nDecay = (p.daughter1() > 0) ? TMath::Max(p.daughter1(), p.daughter2()) - p.daughter1() + 1 : 0;
+				if (iSaved >= 0 && writeTracks) resonances.AddMother(iP, iSaved, p.id(), nDecay);
+				if (p.mother2() == 0) resonances.AddDaughter(p.mother1(), p.id(), isReco);
+
+				if (columnar) { if (iColumn >= 0) columns.SetReco(iColumn, isReco); }
+				else if (track) track->SetStatusCode(isReco ? iP : -1*(iP));
+
+				// reconstructed
+				Bool_t chargedFinalRec = chargedFinal && isReco;
+				// calculate spherocities
+				if (chargedFinal) SK.AddTrack(kin.Px(iP), kin.Py(iP), 
+					chargedFinalRec ? SpherocityKernel::kMaskGen|SpherocityKernel::kMaskRec : SpherocityKernel::kMaskGen);
+				if (chargedFinalRec) nChargedFinalRec++;
+
+				// leading particles for rt, the multiplicities come from the estimators after the loop
+				if (chargedFinal) {
+					if (kin.Pt(iP) > evPtLeadgen) {
+						evPtLeadgen = kin.Pt(iP);
+						evPhiLeadgen = kin.Phi(iP);
+						evEtaLeadgen = kin.Eta(iP);
+					}
+				}
+				if (chargedFinalRec) {
+					if (kin.Pt(iP) > evPtLeadrec) {
+						evPtLeadrec = kin.Pt(iP);
+						evPhiLeadrec = kin.Phi(iP);
+						evEtaLeadrec = kin.Eta(iP);
+					}
+				}
 
-			// v0s, cascades (daughters not reconstructable as primary)
-			for (int iPdg = 3; iPdg < partSize-1; iPdg++) {	
-				if (TMath::Abs(PDGs[iPdg])==p.id()) isReco = ( mcRec < pEffi[iPdg]->Eval(p.pT()) );
-				isReco = isReco && (TMath::Abs(p.eta())<cutEta);
 			}
 
-			// resonances (daughters reconstructed as primaries)
-			// done after particle loop
-					
-			if (isReco) track->SetStatusCode(iP);
-			else track->SetStatusCode(-1*(iP));
-
-			// reconstructed
-			Bool_t chargedFinalRec = chargedFinal && isReco;
-			// calculate spherocities
-			if (chargedFinalRec) {
-				nChargedFinalRec++;
-				TS[rec]->AddTrack(p.px(), p.py());
-				if (p.pT()>0) TS[recNoPt]->AddTrack(p.px()/p.pT(), p.py()/p.pT());
-			}
 
-			// calculate multiplicities
-			if (chargedFinal) {
-				if (TMath::Abs(p.eta()) < 0.8) nChCL++;
-			}
-			if (chargedFinalRec) {
-				if (TMath::Abs(p.eta()) < 0.8) nChCLRec++;
-			}
-			if (p.isFinal() && p.isHadron() && p.isCharged()) {
-				if ( (p.eta() > 2.8 && p.eta() < 5.1)
-				|| (p.eta() > -3.7 && p.eta() < -1.7 ) ) nChV0M++;
+			// a resonance is reco if all daughters of the channel are found and reco
+			for (int iC = 0; iC < resonances.GetNCandidates(); iC++) {
+				if (!resonances.IsComplete(iC)) continue;
+				Int_t iSaved = resonances.GetSavedIndex(iC);
+				if (columnar) columns.SetReco(iSaved, resonances.IsReco(iC));
+				else ((TParticle*)trackArray[iSaved])->SetStatusCode(resonances.IsReco(iC));
 			}
 
-			// calculate rt generated
-			if (chargedFinal) {
-				angles.push_back(p.phi());
-				if (p.pT() > evPtLeadgen) {
-					evPtLeadgen = p.pT();
-					evPhiLeadgen = p.phi();
-					evEtaLeadgen = p.eta();
-				}
+			// Fill other event info
+			if (nChargedFinal > minTracks) {
+				SK.Compute(evSo);
+				if (nChargedFinalRec <= minTracks) evSo[rec] = evSo[recNoPt] = -1;
 			}
-			// calculate rt reconstructed
-			if (chargedFinalRec) {
-				anglesRec.push_back(p.phi());
-				if (p.pT() > evPtLeadrec) {
-					evPtLeadrec = p.pT();
-					evPhiLeadrec = p.phi();
-					evEtaLeadrec = p.eta();
-				}
+			Double_t leadPt[EstimatorEngine::kNLeads] = { evPtLeadgen, evPtLeadrec };
+			Double_t leadPhi[EstimatorEngine::kNLeads] = { evPhiLeadgen, evPhiLeadrec };
+			estimators.Compute(kin.GetN(), kin.GetPt(), kin.GetEta(), kin.GetPhi(), kin.GetFlags(), leadPt, leadPhi);
+			evWeight = pythia.info.weight();
+		
+			// Update trees for this event
+			Clock::time_point tFill = Clock::now();
+			sec[kAnalysis] += seconds(tAnalysis, tFill);
+			if (writeTracks) { if (asyncWrite) writer.Fill(iTreeOut); else tree->Fill(); }
+			if (writeEvents) { if (asyncWrite) writer.Fill(iEventsOut); else events->Fill(); }
+			tAnalysis = Clock::now();
+			sec[kFill] += seconds(tFill, tAnalysis);
+			hGenStat->Fill(1.5);
+			hGenStat->Fill(2.5, evWeight);
+			if (enhanceRt && vetoDryRun && veto->WouldVeto()) {
+				hGenStat->Fill(4.5);
+				if (evPtLeadgen > ptLeadCut) hGenStat->Fill(5.5);
 			}
-
+			for (int iTS = 0; iTS < TSsize; iTS++)
+				if (evSo[iTS] > 0.) hEvSo[iTS]->Fill(evSo[iTS]);
+
+			if (tasks.size()) {
+				AnalysisEvent event = { &kin, &estimators,
+					{ evSo[gen], evSo[genNoPt], evSo[rec], evSo[recNoPt] },
+					{ evPtLeadgen, evPtLeadrec }, { evPhiLeadgen, evPhiLeadrec }, { evEtaLeadgen, evEtaLeadrec },
+					evWeight };
+				for (auto& task : tasks) task->Process(event);
+			}
+			sec[kAnalysis] += seconds(tAnalysis, Clock::now());
+	
+		} // End of event loop.
+
+		if (!vetoDryRun) hGenStat->SetBinContent(1, veto->GetNVetoed());
+		hGenStat->SetBinContent(4, pythia.info.sigmaGen()*nRealEvents);
+		if (veto->GetNTried()) {
+			std::lock_guard<std::mutex> lock(printMutex);
+			cout << "Thread " << iThread << ": " << (vetoDryRun ? "would have vetoed " : "vetoed ") << veto->GetNVetoed()
+				<< " out of " << veto->GetNTried() << " events at parton level" << endl;
+			if (vetoDryRun) cout << "Thread " << iThread << ": " << hGenStat->GetBinContent(6)
+				<< " of them have a leading charged particle above " << ptLeadCut << " GeV/c" << endl;
 		}
 
+		if (columns.GetNOverflows()) 
+			cout << "WARNING: " << columns.GetNOverflows() << " tracks did not fit into the columnar arrays" << endl;
 
-		for (int iP = 0; iP < trackArray.GetEntries(); iP++) {
-			TParticle* track = (TParticle*)trackArray[iP];
-			Int_t pdgCode = track->GetPdgCode();
-			for (int iPdg = phi; iPdg < partSize; ++iPdg)
-			{
-				if (TMath::Abs(track->GetPdgCode())!=PDGs[iPdg]) continue;	// doing this only for phi
-					Bool_t isReco = true;
-					Int_t tracker = 0;
-					for (auto iD : vecPhiDaughters) {	// using a vector to speed things up
-						
-						if (TMath::Abs(track->GetStatusCode()) != ((TParticle*)trackArray[iD])->GetFirstMother()) continue;	// checking if m-d match
-						isReco = isReco && ( ((TParticle*)trackArray[iD])->GetStatusCode() > 0);	// both daughters must be rec.
-						tracker++;
-					}
-					
-					if (tracker==2) track->SetStatusCode(isReco);		// both daughters must be found
-			}
+		if (showInfo) {	// write PYTHIA summary to screen
+			std::lock_guard<std::mutex> lock(printMutex);
+			pythia.stat();
 		}
 
-		// Fill other event info
-		if (nChargedFinal > minTracks) {
-			evSo[gen] = TS[gen]->GetTransverseSpherocityTracks();
-			evSo[genNoPt] = TS[genNoPt]->GetTransverseSpherocityTracks();
-		}
-		if (nChargedFinalRec > minTracks) {
-			evSo[rec] = TS[rec]->GetTransverseSpherocityTracks();
-			evSo[recNoPt] = TS[recNoPt]->GetTransverseSpherocityTracks();
-		}
-		if (evPtLeadgen > ptLeadCut) {
-			for (auto iPhi : angles) if (IsTrans(iPhi,evPhiLeadgen)) nTransCh++;
-			evNchTrans = nTransCh;
-		}
-		if (evPtLeadrec > ptLeadCut) {
-			for (auto iPhi : anglesRec) if (IsTrans(iPhi,evPhiLeadrec)) nTransChRec++;
-			evNchTransRec = nTransChRec;
+		Clock::time_point tWrite = Clock::now();
+		writer.Stop();
+		if (writer.GetNWaits()) {
+			std::lock_guard<std::mutex> lock(printMutex);
+			cout << "Thread " << iThread << ": waited " << writer.GetNWaits() << " times for the writer" << endl;
 		}
 
-		evNchCL = nChCL;
-		evNchCLRec = nChCLRec;
-		evNchV0M = nChV0M;
-		
-		tree->Fill();	// Update tree for this event
-	
-	} // End of event loop.
-  
-	if (showInfo) pythia.stat();	// write PYTHIA summary to screen
-
-	// Write and close output file
-	fout->Write();
-	fout->Close();
+		for (auto& task : tasks) task->Finish();
+		outDir->Write();
+		if (!writeTracks || asyncWrite) delete tree;
+		if (!writeEvents || asyncWrite) delete events;
+		sec[kWrite] += seconds(tWrite, Clock::now());
+
+		std::lock_guard<std::mutex> lock(printMutex);
+		for (int iS = 0; iS < kNStages; iS++) stageSec[iS] += sec[iS];
+		return nRealEvents;
+	};
+
+	int nRealEvents = 0;
+	if (nThreads > 1) {
+		std::vector<std::thread> threads;
+		std::vector<Int_t> nRealThread(nThreads, 0);
+		for (int iT = 0; iT < nThreads; iT++) threads.emplace_back([&, iT]() {
+			std::shared_ptr<TBufferMergerFile> f = merger->GetFile();
+			nRealThread[iT] = generate(iT, f.get());
+		});
+		for (auto& t : threads) t.join();
+		for (auto n : nRealThread) nRealEvents += n;
+
+		Clock::time_point tWrite = Clock::now();
+		mainFile.reset();
+		merger.reset();	// writes out the merged file
+		stageSec[kWrite] += seconds(tWrite, Clock::now());
+	}
+	else {
+		nRealEvents = generate(0, fout);
+		Clock::time_point tWrite = Clock::now();
+		fout->Close();
+		stageSec[kWrite] += seconds(tWrite, Clock::now());
+	}
   
 	// Check to see that we got most of the events we wanted
 	cout << "Real events/simulated: " << nRealEvents << "/ " << nEvents << endl;
+
+	Double_t totalSec = 0;
+	for (int iS = 0; iS < kNStages; iS++) totalSec += stageSec[iS];
+	cout << "Wall time " << Form("%.1f", seconds(tStart, Clock::now())) << " s, time per stage summed over threads:" << endl;
+	for (int iS = 0; iS < kNStages; iS++)
+		cout << Form("  %-14s %10.2f s %6.1f %% %10.1f us/event", stageNames[iS], stageSec[iS],
+			totalSec > 0 ? 100.*stageSec[iS]/totalSec : 0., nRealEvents ? 1e6*stageSec[iS]/nRealEvents : 0.) << endl;
   
 	return 0;
 }
@@ -0,0 +1,404 @@
+// Compiled, multi-threaded version of macros/readTree.C
+// Produces the same output histograms, the chain is processed in parallel
+// with TTreeProcessorMT and every thread fills its own copy of the output,
+// which are merged at the end. Only the branches used are read.
+//
+//	Usage: ./readTreeMT.exe <input.list|input.root> <output.root> [--threads N] [--nevents N] [--exact]
+//
+
+// ROOT includes
+#include <TChain.h>
+#include <TFile.h>
+#include <TH1.h>
+#include <TMath.h>
+#include <TROOT.h>
+#include <TClonesArray.h>
+#include <TParticle.h>
+#include <TParticlePDG.h>
+#include <TDatabasePDG.h>
+#include <TTreeReader.h>
+#include <TEntryList.h>
+#include <RVersion.h>
+#include <ROOT/TTreeProcessorMT.hxx>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TrackColumns/TrackColumns.h"
+#include "DPhiCorrelator/DPhiCorrelator.h"
+#include "EventSelection/EventSelection.h"
+#include "ChainBuilder/ChainBuilder.h"
+
+using namespace std;
+
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,14,0)
+using ROOT::TTreeProcessorMT;
+#else
+using ROOT::Experimental::TTreeProcessorMT;
+#endif
+
+enum { gen , genNoPt, rec, recNoPt, TSsize};
+const char* TSnames[TSsize] = { "gen" , "genNoPt", "rec", "recNoPt"};
+const int nSoCuts = 6;
+const int nSlots = TSsize*(nSoCuts-1);
+
+double DeltaPhi(Double_t phi1, Double_t phi2) {
+
+	Double_t dphi = phi2 - phi1;
+	if ( dphi > TMath::Pi() )		dphi = dphi - 2*TMath::Pi();
+	if ( dphi < -1.*TMath::Pi() )	dphi = dphi + 2*TMath::Pi();
+
+	return dphi;
+}
+
+// Everything one thread fills, merged into the first slot at the end
+struct AnalysisSlot {
+
+	TH1D* hEvSo[TSsize];
+	TH1D* hTrackPt;
+	TH1D* hDPhiSo[TSsize][nSoCuts-1];
+	TH1D* hDPhiSoNeutral[TSsize][nSoCuts-1];
+	DPhiCorrelator corrCharged;
+	DPhiCorrelator corrNeutral;
+	std::vector<Double_t> trEta, trPhi;
+	std::vector<Int_t> trPdg;
+	std::vector<Bool_t> trCharged;
+
+	AnalysisSlot(Int_t id) : corrCharged(nSlots), corrNeutral(nSlots) {
+		TString suffix = id ? Form("_slot%i",id) : "";
+		for (int iTS = 0; iTS < TSsize; ++iTS)
+			hEvSo[iTS] = new TH1D(Form("hEvSo_%s%s",TSnames[iTS],suffix.Data()),"",1000,0.,1.);
+		hTrackPt = new TH1D(Form("hTrackPt%s",suffix.Data()),"",500, -1, 25);
+		for (int iH = 0; iH < nSoCuts-1; ++iH)	{
+		for (int iTS = 0; iTS < TSsize; ++iTS)	{
+			hDPhiSo[iTS][iH] = new TH1D(Form("hDPhiSo_%s_%i%s",TSnames[iTS],iH,suffix.Data()),"",100, -3.2, 3.2);
+			hDPhiSoNeutral[iTS][iH] = new TH1D(Form("hDPhiSoNeutral_%s_%i%s",TSnames[iTS],iH,suffix.Data()),"",100, -3.2, 3.2);
+		}	}
+	}
+
+	void Add(AnalysisSlot& other) {
+		for (int iTS = 0; iTS < TSsize; ++iTS) hEvSo[iTS]->Add(other.hEvSo[iTS]);
+		hTrackPt->Add(other.hTrackPt);
+		for (int iH = 0; iH < nSoCuts-1; ++iH)	{
+		for (int iTS = 0; iTS < TSsize; ++iTS)	{
+			hDPhiSo[iTS][iH]->Add(other.hDPhiSo[iTS][iH]);
+			hDPhiSoNeutral[iTS][iH]->Add(other.hDPhiSoNeutral[iTS][iH]);
+		}	}
+		corrCharged.Add(other.corrCharged);
+		corrNeutral.Add(other.corrNeutral);
+	}
+};
+
+// Hands a free slot to every running task, there are never more slots than concurrent tasks
+class SlotPool {
+ public:
+	AnalysisSlot* Acquire() {
+		std::lock_guard<std::mutex> lock(fMutex);
+		if (fFree.empty()) {
+			fSlots.emplace_back(new AnalysisSlot(fSlots.size()));
+			return fSlots.back().get();
+		}
+		AnalysisSlot* slot = fFree.back();
+		fFree.pop_back();
+		return slot;
+	}
+	void Release(AnalysisSlot* slot) {
+		std::lock_guard<std::mutex> lock(fMutex);
+		fFree.push_back(slot);
+	}
+	AnalysisSlot* Merge() {
+		for (size_t i = 1; i < fSlots.size(); i++) fSlots[0]->Add(*fSlots[i]);
+		return fSlots.empty() ? 0 : fSlots[0].get();
+	}
+ private:
+	std::mutex fMutex;
+	std::vector<std::unique_ptr<AnalysisSlot> > fSlots;
+	std::vector<AnalysisSlot*> fFree;
+};
+
+// Prints the number of processed events and the rate every few seconds
+class ProgressReport {
+ public:
+	ProgressReport(const char* name, Long64_t total) : fName(name), fTotal(total), fCount(0), fDone(false) {
+		fStart = std::chrono::steady_clock::now();
+		fThread = std::thread([this]() {
+			while (!fDone) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(200));
+				if (++fTicks % 25 == 0 && !fDone) Print();
+			}
+		});
+	}
+	~ProgressReport() { Stop(); }
+	void Add(Long64_t n) { fCount += n; }
+	void Stop() {
+		if (fDone.exchange(true)) return;
+		fThread.join();
+		Print();
+	}
+	void Print() {
+		Double_t sec = std::chrono::duration<Double_t>(std::chrono::steady_clock::now() - fStart).count();
+		printf("%s: %lld out of %lld events in %.1f s, %.0f events/s\n", fName.Data(), (Long64_t)fCount, fTotal,
+			sec, sec > 0 ? fCount/sec : 0.);
+	}
+ private:
+	TString fName;
+	Long64_t fTotal;
+	std::atomic<Long64_t> fCount;
+	std::atomic<bool> fDone;
+	Int_t fTicks = 0;
+	std::chrono::steady_clock::time_point fStart;
+	std::thread fThread;
+};
+
+int main(int argc, const char **argv) {
+
+	if (argc < 3) {
+		cout << "Usage: " << argv[0] << " <input.list|input.root> <output.root> [--threads N] [--nevents N] [--exact]" << endl;
+		return 1;
+	}
+
+	string inputFile = argv[1];
+	TString outputFile = argv[2];
+	Int_t nThreads = 0;		// 0: all cores
+	Long64_t nEvents = 0;	// 0: all events
+	Bool_t exactPairs = false;
+	for (int iA = 3; iA < argc; iA++) {
+		TString arg = argv[iA];
+		if (arg == "--threads" && iA+1 < argc)		nThreads = stoi(argv[++iA]);
+		else if (arg == "--nevents" && iA+1 < argc)	nEvents = stoll(argv[++iA]);
+		else if (arg == "--exact")					exactPairs = true;
+	}
+
+	// files are checked in parallel and cached in a manifest, the chain gets their entries
+	ChainBuilder builder("tree");
+	builder.SetNThreads(nThreads);
+	if (!builder.Build(inputFile.c_str())) {
+		printf("Couldn't create the chain! \n");
+		return 1;
+	}
+	vector<string> files;
+	for (int iF = 0; iF < builder.GetNFiles(); iF++) files.push_back(builder.GetFile(iF));
+	cout << " Total " << files.size() << " files have been read in, " << builder.GetNOpened() << " opened" << endl;
+	vector<std::string_view> fileViews(files.begin(), files.end());
+
+	TChain chain("tree");
+	builder.MakeChain(&chain);
+	Long64_t nEntries = chain.GetEntries();
+	cout << "Chain created with entries: " << nEntries << "\n";
+	if (!nEntries) return 1;
+	if (nEvents <= 0 || nEvents > nEntries) nEvents = nEntries;
+
+	// event summary tree with the track tree as a friend (the same chain for older files)
+	TChain* evChain = EventSelection::MakeEventChain(&chain);
+
+	TH1::AddDirectory(false);
+	TDatabasePDG::Instance()->GetParticle(211);		// build the PDG table before the threads use it
+	ROOT::EnableImplicitMT(nThreads);
+	cout << "Running with " << ROOT::GetImplicitMTPoolSize() << " threads" << endl;
+
+	TFile* ftest = TFile::Open(files[0].c_str());
+	TTree* ttest = ftest ? (TTree*)ftest->Get("tree") : 0;
+	Bool_t columnar = ttest && ttest->GetBranch("nTracks");
+	delete ftest;
+	cout << "Track format: " << (columnar ? "columnar" : "TParticle") << endl;
+
+	SlotPool pool;
+
+	// Calculate spherocity quantiles from the distributions saved by the generator,
+	// or else from one pass reading only the spherocity branches
+	AnalysisSlot* soSlot = pool.Acquire();
+	if (!builder.GetSoDistributions(soSlot->hEvSo, TSnames, TSsize)) {
+		pool.Release(soSlot);
+		cout << "Spherocity distributions not found in the input, filling them from the tree" << endl;
+		ProgressReport progress("Spherocity quantiles", nEntries);
+		TTreeProcessorMT processor(fileViews, evChain->GetName());
+		processor.Process([&](TTreeReader& reader) {
+			AnalysisSlot* slot = pool.Acquire();
+			TTree* tree = reader.GetTree();
+			Float_t evSo[TSsize];
+			tree->SetBranchStatus("*", 0);
+			for (int iTS = 0; iTS < TSsize; iTS++)	{
+				tree->SetBranchStatus(Form("evSo%s",TSnames[iTS]), 1);
+				tree->SetBranchAddress(Form("evSo%s",TSnames[iTS]), &evSo[iTS]);
+			}
+			Long64_t n = 0;
+			while (reader.Next()) {
+				tree->GetEntry(tree->GetReadEntry());
+				for (int iTS = 0; iTS < TSsize; iTS++)
+					if (evSo[iTS] > 0.) slot->hEvSo[iTS]->Fill(evSo[iTS]);
+				if (++n % 1000 == 0) { progress.Add(n); n = 0; }
+			}
+			progress.Add(n);
+			tree->ResetBranchAddresses();
+			pool.Release(slot);
+		});
+	}
+	double quantileValues[] = { 0.0, 0.2, 0.4, 0.6, 0.8, 1.0 };
+	double cutSo[TSsize][nSoCuts];
+	TH1D** hEvSoAll = pool.Merge()->hEvSo;
+	for (int iTS = 0; iTS < TSsize; ++iTS)
+		hEvSoAll[iTS]->GetQuantiles(nSoCuts, cutSo[iTS], quantileValues);
+
+	TH1D* hEvNchV0M = new TH1D("hEvNchV0M","",100, -1, 99);
+	hEvNchV0M->SetDirectory(gROOT);
+	gROOT->cd();
+	evChain->Draw("evNchV0M>>hEvNchV0M", "", "goff", nEvents);
+	hEvNchV0M->SetDirectory(0);
+
+	// event-level cuts on the summary tree, the tracks are read only for the selected events
+	EventSelection selection;
+	selection.AddCut("evNchCLRec >= 27");
+	selection.AddCut("evSorec >= 0 || evSorecNoPt >= 0");
+	selection.AddCut("evSogen >= 0 || evSogenNoPt >= 0");
+	TEntryList* selected = selection.Select(evChain, nEvents);
+	if (!selected) return 1;
+	Long64_t nSelected = selected->GetN();
+	cout << "Selected " << nSelected << " out of " << nEvents << " events" << endl;
+
+	SlotPool eventPool;
+
+	// Event loop
+	{
+		ProgressReport progress("Event loop", nSelected);
+		TTreeProcessorMT processor(*evChain, *selected);
+		processor.Process([&](TTreeReader& reader) {
+			AnalysisSlot* slot = eventPool.Acquire();
+			TTree* tree = reader.GetTree();
+
+			// only the branches used below are read
+			tree->SetBranchStatus("*", 0);
+			Float_t evSo[TSsize];
+			for (int iTS = 0; iTS < TSsize; iTS++)	{
+				tree->SetBranchStatus(Form("evSo%s",TSnames[iTS]), 1);
+				tree->SetBranchAddress(Form("evSo%s",TSnames[iTS]), &evSo[iTS]);
+			}
+
+			TClonesArray* tracks = 0;
+			TrackColumns columns;
+			if (columnar) {
+				tree->SetBranchStatus("nTracks", 1);
+				tree->SetBranchStatus("tr*", 1);
+				columns.SetBranchAddresses(tree);
+			}
+			else {
+				tree->SetBranchStatus("tracks*", 1);
+				tree->SetBranchAddress("tracks", &tracks);
+			}
+
+			Long64_t n = 0;
+			while (reader.Next()) {
+				if (++n % 1000 == 0) { progress.Add(n); n = 0; }
+				tree->GetEntry(tree->GetReadEntry());
+
+				// unpack the tracks once per event
+				Int_t nTracks = columnar ? columns.GetNTracks() : tracks->GetEntriesFast();
+				slot->trEta.resize(nTracks); slot->trPhi.resize(nTracks);
+				slot->trPdg.resize(nTracks); slot->trCharged.resize(nTracks);
+				for (int iTr = 0; iTr < nTracks; ++iTr)	{
+					if (columnar) {
+						slot->hTrackPt->Fill(columns.Pt(iTr));
+						slot->trEta[iTr] = columns.Eta(iTr);
+						slot->trPhi[iTr] = columns.Phi(iTr);
+						slot->trPdg[iTr] = columns.Pdg(iTr);
+						slot->trCharged[iTr] = columns.IsCharged(iTr);
+					}
+					else {
+						TParticle* t = (TParticle*)tracks->At(iTr);
+						slot->hTrackPt->Fill(t->Pt());
+						slot->trEta[iTr] = t->Eta();
+						slot->trPhi[iTr] = t->Phi();
+						slot->trPdg[iTr] = t->GetPdgCode();
+						slot->trCharged[iTr] = TMath::Abs(t->GetPDG()->Charge()) > 0.001;
+					}
+				}
+
+				// spherocity class of the event for every estimator, -1 if outside all
+				Int_t soClass[TSsize];
+				Bool_t anyClass = false;
+				for (int iTS = 0; iTS < TSsize; ++iTS)	{
+					soClass[iTS] = -1;
+					for (int iSC = 0; iSC < nSoCuts-1; ++iSC)
+						if (evSo[iTS] > cutSo[iTS][iSC] && evSo[iTS] < cutSo[iTS][iSC+1]) soClass[iTS] = iSC;
+					anyClass = anyClass || soClass[iTS] >= 0;
+				}
+				if (!anyClass) continue;
+
+				// ordered pairs as in DPhiCorrelator: every trigger track within |eta| <= 0.8
+				// with every other track, dPhi = phi(assoc) - phi(trigger)
+				if (exactPairs)	{
+					for (int iTr = 0; iTr < nTracks; ++iTr)	{
+						if (TMath::Abs(slot->trEta[iTr]) > 0.8) continue;
+						bool isCharged1 = slot->trCharged[iTr];
+						for (int iTr2 = 0; iTr2 < nTracks; ++iTr2)	{
+							if (iTr2 == iTr) continue;
+							bool isCharged2 = slot->trCharged[iTr2];
+							Double_t dPhi = DeltaPhi(slot->trPhi[iTr], slot->trPhi[iTr2]);
+							for (int iTS = 0; iTS < TSsize; ++iTS)	{
+								if (soClass[iTS] < 0) continue;
+								if (isCharged1 && isCharged2)
+									slot->hDPhiSo[iTS][soClass[iTS]]->Fill(dPhi);
+								if (!isCharged1 && !isCharged2 && slot->trPdg[iTr]!=22 && slot->trPdg[iTr2]!=22)
+									slot->hDPhiSoNeutral[iTS][soClass[iTS]]->Fill(dPhi);
+							}
+						}
+					}
+					continue;
+				}
+
+				// trigger tracks within |eta| <= 0.8, associated tracks without eta cut
+				slot->corrCharged.Reset();
+				slot->corrNeutral.Reset();
+				for (int iTr = 0; iTr < nTracks; ++iTr)	{
+					Bool_t isTrigger = TMath::Abs(slot->trEta[iTr]) <= 0.8;
+					if (slot->trCharged[iTr]) slot->corrCharged.AddTrack(slot->trPhi[iTr], isTrigger);
+					else if (slot->trPdg[iTr]!=22) slot->corrNeutral.AddTrack(slot->trPhi[iTr], isTrigger);
+				}
+				slot->corrCharged.Transform();
+				slot->corrNeutral.Transform();
+				for (int iTS = 0; iTS < TSsize; ++iTS)	{
+					if (soClass[iTS] < 0) continue;
+					slot->corrCharged.Accumulate(iTS*(nSoCuts-1) + soClass[iTS]);
+					slot->corrNeutral.Accumulate(iTS*(nSoCuts-1) + soClass[iTS]);
+				}
+			}
+			progress.Add(n);
+			tree->ResetBranchAddresses();
+			eventPool.Release(slot);
+		});
+	}
+
+	AnalysisSlot* out = eventPool.Merge();
+	if (!out) {
+		cout << "No events processed" << endl;
+		return 1;
+	}
+	for (int iH = 0; iH < nSoCuts-1; ++iH)	{
+	for (int iTS = 0; iTS < TSsize; ++iTS)	{
+		if (!exactPairs) {
+			out->corrCharged.Fill(iTS*(nSoCuts-1) + iH, out->hDPhiSo[iTS][iH]);
+			out->corrNeutral.Fill(iTS*(nSoCuts-1) + iH, out->hDPhiSoNeutral[iTS][iH]);
+		}
+		out->hDPhiSo[iTS][iH]->Scale(1./out->hDPhiSo[iTS][iH]->Integral());
+		out->hDPhiSoNeutral[iTS][iH]->Scale(1./out->hDPhiSoNeutral[iTS][iH]->Integral());
+	}	}
+
+	// Set up output file, same contents as readTree.C
+	TFile* fout = new TFile(outputFile, "RECREATE");
+	for (int iTS = 0; iTS < TSsize; ++iTS) hEvSoAll[iTS]->Write();
+	hEvNchV0M->Write();
+	out->hTrackPt->Write();
+	for (int iH = 0; iH < nSoCuts-1; ++iH)	{
+	for (int iTS = 0; iTS < TSsize; ++iTS)	{
+		out->hDPhiSo[iTS][iH]->Write();
+		out->hDPhiSoNeutral[iTS][iH]->Write();
+	}	}
+	fout->Close();
+
+	return 0;
+}